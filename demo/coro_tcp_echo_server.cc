@@ -2,8 +2,13 @@
 #include "resp/resp/all.hpp"
 #include "server/DB.h"
 #include "server/RedisProtoc.h"
-auto main() -> int {
-    rangedb::DB *db = new rangedb::DB();
+auto main(int argc, char **argv) -> int {
+    rangedb::DBOptions options;
+    // the optional argument is the flash cache directory on a fast local device
+    if (argc > 1) {
+        options.flash_cache_dir_ = argv[1];
+    }
+    rangedb::DB *db = new rangedb::DB(options);
     auto make_tcp_echo_server = [db](std::shared_ptr<coro::io_scheduler> scheduler) -> coro::task<void> {
         auto make_on_connection_task = [db](coro::net::tcp::client client) -> coro::task<void> {
             rangedb::Bytebuffer buffer(1024);
@@ -0,0 +1,21 @@
+#pragma once
+#include "storage/block/Block.h"
+#include "storage/wal/WalDefinations.h"
+#include <string>
+
+namespace rangedb {
+// Options of one write
+struct WriteOptions {
+    // most keys can lose the last MXLOG_SYNC_INTERVAL_MS of writes on a machine crash and do
+    // not pay the fdatasync, Synced waits for the syncer
+    storage::MXLogDurability durability_ = storage::MXLogDurability::Buffered;
+};
+
+// Options of a DB, fixed when it is opened
+struct DBOptions {
+    // directory of the flash cache on a fast local device, empty disables the flash tier
+    std::string flash_cache_dir_;
+    // size of the flash cache file in bytes
+    size_t flash_cache_capacity_ = storage::FLASH_CACHE_CAPACITY;
+};
+} // namespace rangedb
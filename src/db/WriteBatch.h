@@ -0,0 +1,68 @@
+#pragma once
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "storage/walblock/WalBlock.h"
+#include "utils/Slice.h"
+
+namespace rangedb {
+// WriteBatch collects puts applied by DB::Write as one unit: the records are appended back to
+// back to the mutable memtable under one lock and take one lsn range. Every record carries the
+// number of records of the batch left, so recovery drops a batch whose tail is missing. A batch
+// with keys of several memtable streams is appended in parts committed together, see
+// LsmTable::Write. The index publishes the batch to readers at once, once all of it is
+// appended. A later put of a key in the batch replaces the earlier one.
+class WriteBatch {
+public:
+    // The batch keeps a copy of value
+    void Put(const ByteKey &key, const char *value, size_t size, uint64_t version = 0) {
+        values_.emplace_back(value, size);
+        Slice slice;
+        slice.key_ = key;
+        slice.version_ = version;
+        slice.data_ = resp::buffer(values_.back().data(), values_.back().size());
+        slice.data_length_ = slice.Size();
+        byte_size_ += storage::RecordSize(slice);
+        max_record_size_ = std::max<size_t>(max_record_size_, storage::RecordSize(slice));
+        slices_.push_back(slice);
+    }
+
+    void Clear() {
+        values_.clear();
+        slices_.clear();
+        byte_size_ = 0;
+        max_record_size_ = 0;
+        first_lsn_ = 0;
+        last_lsn_ = 0;
+    }
+
+    size_t Count() const { return slices_.size(); }
+
+    // Bytes the records of the batch take in a memtable block
+    size_t ByteSize() const { return byte_size_; }
+
+    size_t MaxRecordSize() const { return max_record_size_; }
+
+    // The records in put order, their positions are set once the batch is appended
+    std::vector<Slice> &GetSlices() { return slices_; }
+
+    // The lsns of the records of the batch once it is appended: after first_lsn, up to last_lsn
+    void SetLsnRange(uint64_t first_lsn, uint64_t last_lsn) {
+        first_lsn_ = first_lsn;
+        last_lsn_ = last_lsn;
+    }
+    uint64_t GetFirstLsn() const { return first_lsn_; }
+    uint64_t GetLastLsn() const { return last_lsn_; }
+
+private:
+    // values of the puts, a deque keeps the ones the slices point to in place
+    std::deque<std::string> values_;
+    std::vector<Slice> slices_;
+    size_t byte_size_ = 0;
+    size_t max_record_size_ = 0;
+    uint64_t first_lsn_ = 0;
+    uint64_t last_lsn_ = 0;
+};
+} // namespace rangedb
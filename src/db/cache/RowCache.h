@@ -0,0 +1,64 @@
+#pragma once
+#include "utils/ShardedCache.h"
+#include "utils/Slice.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace rangedb {
+// default memory budget of the row cache in bytes, 0 disables it
+const size_t ROW_CACHE_CAPACITY = 64 * 1024 * 1024;
+const uint32_t ROW_CACHE_SHARD_BITS = 6;
+
+struct ByteKeyHash {
+    size_t operator()(const ByteKey &key) const { return key.hash_0_; }
+};
+
+// decoded value of the record of a key at one position in the sst files
+struct RowEntry {
+    uint64_t file_id_;
+    uint32_t block_id_;
+    uint64_t offset_;
+    std::string value_;
+};
+using RowEntryPtr = std::shared_ptr<const RowEntry>;
+
+// RowCache keeps the decoded values of hot keys read from sst blocks, a hit
+// skips fetching the 64KB block and deserializing the record. An entry is only
+// valid for the record position it was filled from. A rewritten key is indexed
+// at a new position once it is flushed, file ids are never reused, so the stale
+// entry no longer matches and the lookup misses.
+class RowCache {
+public:
+    RowCache(size_t capacity = ROW_CACHE_CAPACITY) : cache_(capacity, ROW_CACHE_SHARD_BITS) {}
+
+    // Fill the value of source if the entry was filled from the record source points to,
+    // the value points into the cached entry and source keeps the entry alive
+    bool Lookup(Slice *source) {
+        RowEntryPtr entry = nullptr;
+        if (!cache_.Lookup(source->key_, entry) || entry->file_id_ != source->file_id_ || entry->block_id_ != source->block_id_ ||
+            entry->offset_ != source->offset_) {
+            return false;
+        }
+        source->data_ = resp::buffer(entry->value_.data(), entry->value_.size());
+        source->data_holder_ = entry;
+        return true;
+    }
+
+    // Cache the value of the record source was read from
+    void Insert(const Slice *source) {
+        auto entry = std::make_shared<const RowEntry>(
+            RowEntry{source->file_id_, source->block_id_, source->offset_, std::string(source->data_.data(), source->data_.size())});
+        cache_.Insert(source->key_, entry, sizeof(RowEntry) + sizeof(ByteKey) + entry->value_.capacity());
+    }
+
+    void Erase(const ByteKey &key) { cache_.Erase(key); }
+
+    void SetCapacity(size_t capacity) { cache_.SetCapacity(capacity); }
+
+    size_t GetUsage() { return cache_.GetUsage(); }
+
+private:
+    ShardedCache<ByteKey, RowEntryPtr, ByteKeyHash> cache_;
+};
+} // namespace rangedb
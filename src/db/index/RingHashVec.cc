@@ -1,29 +1,67 @@
 #include "db/index/RingHashVec.h"
+#include <algorithm>
 #include <cmath>
 namespace rangedb {
-RingHashVec::RingHashVec(/* args */) {
+RingHashVec::RingHashVec(/* args */) : table_num_(0) {
     ring_level_ = 12;
     int vec_size = 1 << ring_level_;
     hash_tables_.resize(vec_size);
     for (int i = 0; i < vec_size; i++) {
         hash_tables_[i] = new SplitNode();
         hash_tables_[i]->split_level_ = 0;
+        hash_tables_[i]->table_num_ = &table_num_;
         for (int j = 0; j < 1; j++) {
             hash_tables_[i]->hash_tables_.resize(32);
             hash_tables_[i]->hash_tables_[j] = new db::HashTable();
+            table_num_++;
         }
     }
 }
 
-RingHashVec::~RingHashVec() {}
+RingHashVec::~RingHashVec() {
+    for (SplitNode *node : hash_tables_) {
+        // a split shares a table between neighbouring shift indexes until it is split again
+        db::HashTable *last = nullptr;
+        for (db::HashTable *table : node->hash_tables_) {
+            if (table != nullptr && table != last) {
+                delete table;
+            }
+            last = table;
+        }
+        delete node;
+    }
+}
+
 void RingHashVec::insert(Slice *slice) {
-    int64_t hash = slice->key_.hash_0_;
-    int64_t ring_index = std::abs(hash / (1 << (64 - ring_level_))) % (1 << ring_level_);
+    int64_t ring_index = GetRingIndex(slice->key_.hash_0_);
     hash_tables_[ring_index]->put(ring_level_, slice);
 }
+void RingHashVec::insert(std::vector<Slice> &slices) {
+    std::vector<std::pair<int64_t, Slice *>> partitions;
+    partitions.reserve(slices.size());
+    for (auto &slice : slices) {
+        partitions.emplace_back(GetRingIndex(slice.key_.hash_0_), &slice);
+    }
+    // stable, the slices of a key keep their put order
+    std::stable_sort(partitions.begin(), partitions.end(),
+                     [](const std::pair<int64_t, Slice *> &a, const std::pair<int64_t, Slice *> &b) { return a.first < b.first; });
+    // in ring order, two batches never wait on each other's locks
+    std::vector<WriteLock> locks;
+    for (size_t i = 0; i < partitions.size(); i++) {
+        if (i == 0 || partitions[i].first != partitions[i - 1].first) {
+            locks.emplace_back(hash_tables_[partitions[i].first]->split_lock_);
+        }
+    }
+    for (auto &partition : partitions) {
+        hash_tables_[partition.first]->PutLocked(ring_level_, partition.second);
+    }
+}
+bool RingHashVec::TryInsert(const Slice *expected, Slice *slice) {
+    int64_t ring_index = GetRingIndex(slice->key_.hash_0_);
+    return hash_tables_[ring_index]->PutIf(ring_level_, expected, slice);
+}
 bool RingHashVec::find(Slice *slice) {
-    int64_t hash = slice->key_.hash_0_;
-    int64_t ring_index = std::abs(hash / (1 << (64 - ring_level_))) % (1 << ring_level_);
+    int64_t ring_index = GetRingIndex(slice->key_.hash_0_);
     return hash_tables_[ring_index]->get(ring_level_, slice);
 }
 void Rehash() {}
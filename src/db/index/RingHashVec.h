@@ -3,6 +3,7 @@
 
 #include "db/index/HashTable.h"
 #include "utils/Slice.h"
+#include <atomic>
 #include <cmath>
 #include <shared_mutex>
 
@@ -42,35 +43,51 @@ private:
         std::vector<db::HashTable*> hash_tables_;
         int split_level_;
         Lock split_lock_;
+        std::atomic<size_t>* table_num_;
         void put(uint64_t ring_level, Slice* source) {
-            bool flag = false;
-            {
-                WriteLock lock(split_lock_);
-                int shift_index = GetShiftIndex(source->key_.hash_0_, ring_level, split_level_);
-                if (hash_tables_[shift_index]->GetSize() < 1000) {
-                    hash_tables_[shift_index]->put(source);
+            WriteLock lock(split_lock_);
+            PutLocked(ring_level, source);
+        }
+        void PutLocked(uint64_t ring_level, Slice* source) {
+            int shift_index = GetShiftIndex(source->key_.hash_0_, ring_level, split_level_);
+            if (hash_tables_[shift_index]->GetSize() < 1000) {
+                hash_tables_[shift_index]->put(source);
+            } else {
+                int64_t ring_index = GetRingIndex(source->key_.hash_0_, ring_level);
+                bool shift = false;
+                if (split_level_ == 0) {
+                    shift = true;
                 } else {
-                    int64_t ring_index = GetRingIndex(source->key_.hash_0_, ring_level);
-                    bool shift = false;
-                    if (split_level_ == 0) {
-                        shift = true;
+                    if (shift_index % 2 == 1) {
+                        if(hash_tables_[shift_index] != hash_tables_[shift_index - 1]) {
+                            shift = true;
+                        }
                     } else {
-                        if (shift_index % 2 == 1) {
-                            if(hash_tables_[shift_index] != hash_tables_[shift_index - 1]) {
-                                shift = true;
-                            }
-                        } else {
-                            if (hash_tables_[shift_index] != hash_tables_[shift_index + 1]) {
-                                shift = true;
-                            }
+                        if (hash_tables_[shift_index] != hash_tables_[shift_index + 1]) {
+                            shift = true;
                         }
                     }
-                    hashSplit(ring_level, split_level_, shift_index, shift);
-                    int shift_index = GetShiftIndex(source->key_.hash_0_, ring_level, split_level_);
-                    hash_tables_[shift_index]->put(source);
                 }
+                hashSplit(ring_level, split_level_, shift_index, shift);
+                int shift_index = GetShiftIndex(source->key_.hash_0_, ring_level, split_level_);
+                hash_tables_[shift_index]->put(source);
             }
         }
+        // replace the entry of the key only while it still points at the position of expected,
+        // the check and the put hold one lock so a newer put of the key is never overwritten
+        bool PutIf(uint64_t ring_level, const Slice* expected, Slice* source) {
+            WriteLock lock(split_lock_);
+            Slice current;
+            current.key_ = source->key_;
+            int shift_index = GetShiftIndex(source->key_.hash_0_, ring_level, split_level_);
+            if (!hash_tables_[shift_index]->get(&current) || current.block_type_ != expected->block_type_ ||
+                current.file_id_ != expected->file_id_ || current.block_id_ != expected->block_id_ ||
+                current.offset_ != expected->offset_) {
+                return false;
+            }
+            PutLocked(ring_level, source);
+            return true;
+        }
         bool get(uint64_t ring_level, Slice* source) {
             ReadLock lock(split_lock_);
             int shift_index = GetShiftIndex(source->key_.hash_0_, ring_level, split_level_);
@@ -79,6 +96,7 @@ private:
         }
         void hashSplit(int ring_level, int shift_level, int split_index, bool shift) {
             db::HashTable* new_table = new db::HashTable();
+            table_num_->fetch_add(1, std::memory_order_relaxed);
             if (shift) {
                 shift_level += 1;
                 int node_num = 1 << shift_level;
@@ -108,20 +126,35 @@ private:
     };
     int ring_level_;
     std::vector<SplitNode*> hash_tables_;
+    // hash tables allocated so far, the index only grows
+    std::atomic<size_t> table_num_;
 public:
     RingHashVec(/* args */);
     ~RingHashVec();
 
-    bool TryInsert(const Slice* slice);
+    // Insert slice only if the entry of its key is still at the position (block type, file,
+    // block and offset) of expected, false if the key was put elsewhere or is missing
+    bool TryInsert(const Slice* expected, Slice* slice);
 
     void insert(Slice* slice);
 
+    // Insert the slices of a write batch at once: the split nodes they land on are locked in
+    // ring order before the first slice is put and unlocked after the last, so a reader finds
+    // either none or all of them. A later slice of a key replaces an earlier one.
+    void insert(std::vector<Slice>& slices);
+
     bool find(Slice* slice);
 
     bool TryFind(Slice* slice);
 
     void Print();
 
+    // Partition of the ring a key hash lands on, every key of a partition shares its locks
+    inline int64_t GetRingIndex(int64_t hash) const { return std::abs(hash / (1 << (64 - ring_level_))) % (1 << ring_level_); }
+
+    // Bytes held by the hash tables of the index
+    size_t GetMemoryUsage() const { return table_num_.load(std::memory_order_relaxed) * sizeof(db::HashTable); }
+
     bool Rehash();
     /*
     It deletes the element containing
@@ -24,6 +24,7 @@ StatusCode MemManager::Get(Task* task) {
     bool exist = block_cache_.get(block_id, block);
     if (exist) {
         block->Read(source);
+        source->data_holder_ = block;
     } else {
         task->action_ = TaskType::GET_FROM_DISK;
     }
@@ -0,0 +1,131 @@
+#include "db/mem/MemoryGovernor.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace rangedb {
+namespace db {
+
+MemoryGovernor::MemoryGovernor(size_t budget, uint64_t interval_ms) : budget_(budget), interval_ms_(interval_ms), stalled_(false), index_over_budget_(false), stop_(true) {
+    for (auto &usage : usage_) {
+        usage = 0;
+    }
+}
+
+MemoryGovernor::~MemoryGovernor() { Stop(); }
+
+void MemoryGovernor::RegisterConsumer(MemoryComponent component, UsageFunc usage) {
+    consumers_[(size_t)component] = Consumer{std::move(usage), nullptr, 0};
+}
+
+void MemoryGovernor::RegisterCache(MemoryComponent component, UsageFunc usage, ResizeFunc resize, size_t capacity) {
+    consumers_[(size_t)component] = Consumer{std::move(usage), std::move(resize), capacity};
+}
+
+void MemoryGovernor::Start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!stop_) {
+        return;
+    }
+    stop_ = false;
+    thread_ = std::thread([this]() { Run(); });
+}
+
+void MemoryGovernor::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stop_) {
+            return;
+        }
+        stop_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+    // never leave a writer blocked behind a governor that is gone
+    stalled_ = false;
+    cv_.notify_all();
+}
+
+size_t MemoryGovernor::GetTotalUsage() const {
+    size_t total = 0;
+    for (auto &usage : usage_) {
+        total += usage.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void MemoryGovernor::Update() {
+    size_t budget = budget_.load();
+    size_t fixed_usage = 0;
+    size_t cache_capacity = 0;
+    size_t cache_min = 0;
+    for (size_t i = 0; i < consumers_.size(); i++) {
+        Consumer &consumer = consumers_[i];
+        if (consumer.usage_ == nullptr) {
+            continue;
+        }
+        usage_[i] = consumer.usage_();
+        if (consumer.resize_ == nullptr) {
+            fixed_usage += usage_[i];
+        } else {
+            cache_capacity += consumer.capacity_;
+            cache_min += consumer.capacity_ / MEMORY_CACHE_MIN_DIVISOR;
+        }
+    }
+    // the caches get what the index and the memtables leave
+    size_t cache_budget = budget > fixed_usage ? budget - fixed_usage : 0;
+    cache_budget = std::max(cache_budget, cache_min);
+    for (auto &consumer : consumers_) {
+        if (consumer.resize_ == nullptr || cache_capacity == 0) {
+            continue;
+        }
+        size_t capacity = (size_t)((double)cache_budget * consumer.capacity_ / cache_capacity);
+        consumer.resize_(std::clamp(capacity, consumer.capacity_ / MEMORY_CACHE_MIN_DIVISOR, consumer.capacity_));
+    }
+    // flushes free the memtables only, so only the memtables trigger them and the stall
+    size_t index_usage = usage_[(size_t)MemoryComponent::INDEX];
+    size_t memtable_usage = usage_[(size_t)MemoryComponent::MEMTABLE];
+    size_t reserved = index_usage + cache_min;
+    bool index_over_budget = reserved >= budget * MEMORY_STALL_RATIO;
+    if (index_over_budget != index_over_budget_.load()) {
+        std::cout << "index usage " << index_usage << (index_over_budget ? " over" : " back under") << " the budget " << budget
+                  << std::endl;
+        index_over_budget_ = index_over_budget;
+    }
+    size_t memtable_budget = budget > reserved ? budget - reserved : 0;
+    memtable_budget = std::max(memtable_budget, budget / MEMORY_MEMTABLE_MIN_DIVISOR);
+    if (memtable_usage >= memtable_budget * MEMORY_FLUSH_RATIO && flush_callback_ != nullptr) {
+        flush_callback_();
+    }
+    bool stalled = stalled_.load();
+    if (!stalled && memtable_usage >= memtable_budget * MEMORY_STALL_RATIO) {
+        std::cout << "memtable usage " << memtable_usage << " over the stall limit of memtable budget " << memtable_budget
+                  << ", stall writes" << std::endl;
+        stalled_ = true;
+    } else if (stalled && memtable_usage < memtable_budget * MEMORY_RESUME_RATIO) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stalled_ = false;
+        cv_.notify_all();
+    }
+}
+
+void MemoryGovernor::WaitForWrite() {
+    if (!stalled_.load(std::memory_order_relaxed)) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]() { return !stalled_.load() || stop_; });
+}
+
+void MemoryGovernor::Run() {
+    while (true) {
+        Update();
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (cv_.wait_for(lock, std::chrono::milliseconds(interval_ms_), [this]() { return stop_; })) {
+            break;
+        }
+    }
+}
+
+} // namespace db
+} // namespace rangedb
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace rangedb {
+namespace db {
+
+// default process wide memory budget in bytes
+const size_t MEMORY_BUDGET = 4ULL * 1024 * 1024 * 1024;
+const uint64_t MEMORY_GOVERNOR_INTERVAL_MS = 100;
+// the memtables may use what the index and the caches shrunk to their minimum leave of the
+// budget, never less than 1/MEMORY_MEMTABLE_MIN_DIVISOR of it; they are flushed once they use
+// MEMORY_FLUSH_RATIO of that, writes stall at MEMORY_STALL_RATIO and resume below
+// MEMORY_RESUME_RATIO
+const size_t MEMORY_MEMTABLE_MIN_DIVISOR = 16;
+const double MEMORY_FLUSH_RATIO = 0.6;
+const double MEMORY_STALL_RATIO = 0.95;
+const double MEMORY_RESUME_RATIO = 0.85;
+// caches are never shrunk below 1/MEMORY_CACHE_MIN_DIVISOR of their configured capacity
+const size_t MEMORY_CACHE_MIN_DIVISOR = 16;
+
+enum class MemoryComponent : uint8_t {
+    INDEX,
+    MEMTABLE,
+    BLOCK_CACHE,
+    COMPRESSED_BLOCK_CACHE,
+    RECORD_CACHE,
+    ROW_CACHE,
+    COMPONENT_NUM,
+};
+
+// MemoryGovernor enforces one memory budget across the components of the DB.
+// Every component registers a probe of its usage, caches also register a way
+// to resize them. A background thread polls the probes and
+//   - gives the caches whatever the index and the memtables leave of the budget,
+//     split by their configured capacities,
+//   - asks for a memtable flush past MEMORY_FLUSH_RATIO of the memtable budget,
+//   - stalls writers in WaitForWrite past MEMORY_STALL_RATIO of the memtable budget.
+// Flushes free the memtables only, not the index, so an index that outgrows the budget is
+// reported by IsIndexOverBudget instead of stalling the writers for good.
+// Register everything before Start.
+class MemoryGovernor {
+public:
+    using UsageFunc = std::function<size_t()>;
+    using ResizeFunc = std::function<void(size_t capacity)>;
+
+    MemoryGovernor(size_t budget = MEMORY_BUDGET, uint64_t interval_ms = MEMORY_GOVERNOR_INTERVAL_MS);
+    ~MemoryGovernor();
+
+    void RegisterConsumer(MemoryComponent component, UsageFunc usage);
+
+    // A cache is resized between capacity / MEMORY_CACHE_MIN_DIVISOR and capacity
+    void RegisterCache(MemoryComponent component, UsageFunc usage, ResizeFunc resize, size_t capacity);
+
+    // Called from the governor thread when the memtables should be flushed
+    void SetFlushCallback(std::function<void()> callback) { flush_callback_ = std::move(callback); }
+
+    void Start();
+
+    void Stop();
+
+    // Poll the usage of every component and apply the policy once
+    void Update();
+
+    // Block the writer while the memory is over the stall limit
+    void WaitForWrite();
+
+    void SetBudget(size_t budget) { budget_.store(budget); }
+
+    size_t GetBudget() const { return budget_.load(); }
+
+    size_t GetUsage(MemoryComponent component) const { return usage_[(size_t)component].load(std::memory_order_relaxed); }
+
+    size_t GetTotalUsage() const;
+
+    bool IsStalled() const { return stalled_.load(); }
+
+    // The index and the caches shrunk to their minimum use more than MEMORY_STALL_RATIO of
+    // the budget, only a larger budget helps
+    bool IsIndexOverBudget() const { return index_over_budget_.load(); }
+
+private:
+    struct Consumer {
+        UsageFunc usage_;
+        ResizeFunc resize_;
+        size_t capacity_;
+    };
+
+    void Run();
+
+    std::atomic<size_t> budget_;
+    uint64_t interval_ms_;
+    std::array<Consumer, (size_t)MemoryComponent::COMPONENT_NUM> consumers_;
+    std::array<std::atomic<size_t>, (size_t)MemoryComponent::COMPONENT_NUM> usage_;
+    std::function<void()> flush_callback_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::atomic<bool> stalled_;
+    std::atomic<bool> index_over_budget_;
+    bool stop_;
+    std::thread thread_;
+};
+
+} // namespace db
+} // namespace rangedb
@@ -1,6 +1,7 @@
 #include "server/DB.h"
 #include "storage/block/Block.h"
 #include "storage/block/BlockFile.h"
+#include "storage/sstblock/SstBlockFile.h"
 #include "table/LsmTable.h"
 #include "utils/Manifest.h"
 #include "utils/Slice.h"
@@ -9,94 +10,268 @@
 #include <cstdint>
 namespace rangedb {
 
-DB::DB(/* args */) {
+DB::DB(const DBOptions &options) : options_(options) {
     mem_vector_ = new RingHashVec();
-    wal_put_thread_.detach();
     wal_manager_ = std::make_shared<WalManager>();
     block_manager_ = BlockManager::GetInstance();
+    io_schedual_ = BlockIOSchedual::GetInstance();
     lsm_table_ = new LsmTable(mem_vector_);
+    cache_warmer_ = new BlockCacheWarmer(storage::BLOCK_CACHE_DUMP_FILE);
+    row_cache_ = ROW_CACHE_CAPACITY > 0 ? new RowCache(ROW_CACHE_CAPACITY) : nullptr;
+    memory_governor_ = new db::MemoryGovernor();
+    InitMemoryGovernor();
     Init();
 }
 
+void DB::InitMemoryGovernor() {
+    memory_governor_->RegisterConsumer(db::MemoryComponent::INDEX, [this]() { return mem_vector_->GetMemoryUsage(); });
+    memory_governor_->RegisterConsumer(db::MemoryComponent::MEMTABLE, [this]() { return lsm_table_->GetMemoryUsage(); });
+    memory_governor_->RegisterCache(
+        db::MemoryComponent::BLOCK_CACHE, [this]() { return block_manager_->GetBlockCacheUsage(); },
+        [this](size_t capacity) { block_manager_->SetBlockCacheCapacity(capacity); }, storage::BLOCK_CACHE_CAPACITY);
+    if (block_manager_->HasCompressedCache()) {
+        memory_governor_->RegisterCache(
+            db::MemoryComponent::COMPRESSED_BLOCK_CACHE, [this]() { return block_manager_->GetCompressedCacheUsage(); },
+            [this](size_t capacity) { block_manager_->SetCompressedCacheCapacity(capacity); }, storage::COMPRESSED_BLOCK_CACHE_CAPACITY);
+    }
+    memory_governor_->RegisterCache(
+        db::MemoryComponent::RECORD_CACHE, [this]() { return block_manager_->GetRecordCacheUsage(); },
+        [this](size_t capacity) { block_manager_->SetRecordCacheCapacity(capacity); }, storage::RECORD_CACHE_CAPACITY);
+    if (row_cache_ != nullptr) {
+        memory_governor_->RegisterCache(
+            db::MemoryComponent::ROW_CACHE, [this]() { return row_cache_->GetUsage(); },
+            [this](size_t capacity) { row_cache_->SetCapacity(capacity); }, ROW_CACHE_CAPACITY);
+    }
+    memory_governor_->SetFlushCallback([this]() { lsm_table_->RequestFlush(); });
+}
+
+DB::~DB() {
+    // dump the hottest blocks for the next start
+    cache_warmer_->Stop();
+    delete cache_warmer_;
+    memory_governor_->Stop();
+    delete memory_governor_;
+    delete row_cache_;
+}
+
 void DB::FlushWal() { wal_manager_->Flush(); }
 
-Status DB::Put(Slice *source) {
-    Status status = lsm_table_->Put(source);
-    mem_vector_->insert(source);
-    return status;
+Status DB::Put(Slice *source, const WriteOptions &options) {
+    // writes wait here while the memory is over budget and the memtables are flushed
+    memory_governor_->WaitForWrite();
+    // the record appended to the memtable block is the log record, it is indexed with the append
+    return lsm_table_->Put(source, options.durability_);
+}
+
+coro::task<Status> DB::AsyncPut(Slice *source, WriteOptions options) {
+    memory_governor_->WaitForWrite();
+    bool wait_sync = options.durability_ == storage::MXLogDurability::Synced;
+    uint64_t lsn = 0;
+    Status status = lsm_table_->Put(source, wait_sync ? storage::MXLogDurability::Buffered : options.durability_, &lsn);
+    if (!status.ok()) {
+        co_return status;
+    }
+    if (wait_sync) {
+        coro::event event;
+        bool synced = false;
+        lsm_table_->AsyncWaitForSync(lsn, [&event, &synced](bool ok) {
+            synced = ok;
+            event.set();
+        });
+        co_await event;
+        // the record is indexed with the append, only the ack waits until it is as durable as asked
+        if (!synced) {
+            co_return Status(DB_ERROR, "sync wal failed");
+        }
+    }
+    co_return status;
+}
+
+Status DB::Write(WriteBatch *batch, const WriteOptions &options) {
+    memory_governor_->WaitForWrite();
+    return lsm_table_->Write(batch, options.durability_);
+}
+
+coro::task<Status> DB::AsyncWrite(WriteBatch *batch, WriteOptions options) {
+    memory_governor_->WaitForWrite();
+    bool wait_sync = options.durability_ == storage::MXLogDurability::Synced;
+    uint64_t lsn = 0;
+    Status status = lsm_table_->Write(batch, wait_sync ? storage::MXLogDurability::Buffered : options.durability_, &lsn);
+    if (!status.ok()) {
+        co_return status;
+    }
+    if (wait_sync) {
+        coro::event event;
+        bool synced = false;
+        lsm_table_->AsyncWaitForSync(lsn, [&event, &synced](bool ok) {
+            synced = ok;
+            event.set();
+        });
+        co_await event;
+        if (!synced) {
+            co_return Status(DB_ERROR, "sync wal failed");
+        }
+    }
+    co_return status;
 }
 
 Status DB::Get(Slice *source) {
-    TaskType type = TaskType::GET_INDEX;
-    Task *task = new Task(source);
-    task->action_ = type;
-    bool exist = mem_vector_->find(task->slice_);
-    Status status;
-    if (!exist) {
-        task->level_ = 2;
-        status = lsm_table_->GetFromLevelFile(source, task);
-        if (task->flag) {
+    Task task(source);
+    task.action_ = TaskType::GET_INDEX;
+    bool exist = mem_vector_->find(task.slice_);
+    Slice *slice = task.slice_;
+    while (exist && slice->block_type_ == 0) {
+        Status status = lsm_table_->GetFromMemBlock(slice);
+        if (status.ok()) {
             return status;
-        } else {
-            // not found
         }
-    } else {
-        Slice *slice = task->slice_;
-        uint64_t file_id = slice->file_id_;
-        if (slice->block_type_ == 0) {
-            status = lsm_table_->GetFromMemBlock(slice);
-            if (status.ok()) {
-                task->done_ = true;
-            } else {
-                auto block = lsm_table_->GetFromLevelFile(source, task);
-            }
+        // the memtable was flushed since the lookup, the flush pointed the index to the sst
+        // copy before it dropped the memtable
+        exist = mem_vector_->find(slice);
+    }
+    if (!exist) {
+        task.level_ = 2;
+        return lsm_table_->GetFromLevelFile(source, &task);
+    }
+    if (row_cache_ != nullptr && row_cache_->Lookup(slice)) {
+        // hot key, the block is not touched
+        return Status::OK();
+    }
+    Status status;
+    uint64_t file_id = slice->file_id_;
+    storage::BlockFilePtr block_file = file_manager_->GetBlockFile(file_id);
+    if (block_file != nullptr) {
+        storage::BlockHandle block = block_manager_->PinBlock(file_id, slice->block_id_);
+        if (block == nullptr && storage::SST_PARTIAL_READ) {
+            status = ReadRecord(block_file, slice);
         } else {
-            storage::BlockFilePtr block_file = file_manager_->GetBlockFile(file_id);
-            if (block_file != nullptr) {
-                storage::BlockPtr block = block_manager_->GetBlock(file_id, slice->block_id_);
-                if (block == nullptr) {
-                    block_manager_->ReadBlock(slice);
-                } else {
-                    block->Read(slice);
-                }
+            if (block == nullptr) {
+                // concurrent misses on the block share one read
+                auto sst_file = std::dynamic_pointer_cast<storage::SstBlockFile>(block_file);
+                block = sst_file->PinBlock(slice->block_id_, CacheHint::NORMAL);
+            }
+            if (block != nullptr) {
+                block->Read(slice);
+                block.HoldValue(slice);
             } else {
-                status = lsm_table_->GetFromLevelFile(source, task);
+                status = Status(DB_READ_BLOCK_ERROR, "read block failed");
             }
         }
+        if (status.ok() && row_cache_ != nullptr) {
+            row_cache_->Insert(slice);
+        }
+    } else {
+        task.level_ = 1;
+        status = lsm_table_->GetFromLevelFile(source, &task);
     }
-    return status;  
+    return status;
+}
+
+Status DB::ReadRecord(storage::BlockFilePtr block_file, Slice *source) {
+    RecordPtr record = block_manager_->GetRecord(source->file_id_, source->block_id_, source->offset_);
+    if (record == nullptr) {
+        auto sst_file = std::dynamic_pointer_cast<storage::SstBlockFile>(block_file);
+        if (sst_file == nullptr) {
+            return Status(DB_READ_BLOCK_ERROR, "not a sst file");
+        }
+        record = sst_file->ReadRecord(source->block_id_, source->offset_, source->data_length_);
+        if (record == nullptr) {
+            return Status(DB_READ_BLOCK_ERROR, "read record failed");
+        }
+        block_manager_->AddRecordCache(source->file_id_, source->block_id_, source->offset_, record);
+    }
+    source->Deserialize((int8_t *)record->data());
+    // the record may be evicted while the caller reads the value
+    source->data_holder_ = record;
+    return Status::OK();
+}
+
+coro::task<Status> DB::AsyncGet(Slice *source) {
+    Task task(source);
+    task.action_ = TaskType::GET_INDEX;
+    bool exist = mem_vector_->find(source);
+    while (exist && source->block_type_ == 0) {
+        if (lsm_table_->GetFromMemBlock(source).ok()) {
+            co_return Status::OK();
+        }
+        // flushed since the lookup, as in Get
+        exist = mem_vector_->find(source);
+    }
+    if (!exist) {
+        co_return Status(DB_NOT_FOUND, "key not found");
+    }
+    if (row_cache_ != nullptr && row_cache_->Lookup(source)) {
+        co_return Status::OK();
+    }
+    storage::BlockHandle block = block_manager_->PinBlock(source->file_id_, source->block_id_);
+    if (block == nullptr) {
+        // never hold a pinned epoch across the suspension
+        if (!io_schedual_->ReadBlock(&task)) {
+            co_return Status(DB_READ_BLOCK_ERROR, "schedule block read failed");
+        }
+        co_await task.event_;
+        block = block_manager_->PinBlock(source->file_id_, source->block_id_);
+        if (block == nullptr) {
+            co_return Status(DB_READ_BLOCK_ERROR, "read block failed, result: " + std::to_string(task.io_result_));
+        }
+    }
+    block->Read(source);
+    block.HoldValue(source);
+    if (row_cache_ != nullptr) {
+        row_cache_->Insert(source);
+    }
+    co_return Status::OK();
 }
 
 void DB::AppendWal() {}
 
+void DB::ReplayWal() {
+    std::list<FileInfo *> file_lst;
+    file_manager_->GetLevelFile(0, &file_lst);
+    std::vector<WalBlockFilePtr> files;
+    for (auto &file_info : file_lst) {
+        auto file = std::dynamic_pointer_cast<WalBlockFile>(file_manager_->GetBlockFile(file_info->file_id_));
+        if (file != nullptr) {
+            files.push_back(file);
+        }
+    }
+    uint64_t record_num = lsm_table_->Recover(files);
+    if (record_num > 0) {
+        std::cout << "recovered " << record_num << " records from " << files.size() << " wal block files" << std::endl;
+    }
+}
+
 void DB::Init() {
     manifest_ptr_ = Manifest::ManifestGetInstance();
     std::vector<FileInfo> file_info_lst;
     manifest_ptr_->ReadFileRecode(&file_info_lst);
     file_manager_ = FileManager::GetInstance();
     file_manager_->InitBlockFile(file_info_lst);
-    std::list<FileInfo *> file_lst;
-    file_manager_->GetLevelFile(0, &file_lst);
-    // init index cache for wal block and level 0 block
-    for (auto &file_info : file_lst) {
-        auto block = file_manager_->GetBlockFile(file_info->file_id_);
-        auto iter = block->NewIterator(ByteKeyComparator());
-        while (!iter->End()) {
-            ByteKey key = iter->Key();
-            Slice value = iter->Value();
-            mem_vector_->insert(&value);
+    if (!options_.flash_cache_dir_.empty()) {
+        Status status = block_manager_->EnableFlashCache(options_.flash_cache_dir_, options_.flash_cache_capacity_);
+        if (!status.ok()) {
+            std::cout << "enable flash cache failed: " << status.ToString() << std::endl;
         }
     }
-    file_lst.clear();
+    std::list<FileInfo *> file_lst;
     file_manager_->GetLevelFile(1, &file_lst);
+    // the records of a newer memtable replace the older ones, the flushes may finish out of order
+    file_lst.sort([](const FileInfo *a, const FileInfo *b) { return a->mem_file_id_ < b->mem_file_id_; });
     for (auto &file_info : file_lst) {
         auto block = file_manager_->GetBlockFile(file_info->file_id_);
         auto iter = block->NewIterator(ByteKeyComparator());
+        iter->SeekToFirst();
         while (!iter->End()) {
-            ByteKey key = iter->Key();
             Slice value = iter->Value();
             mem_vector_->insert(&value);
+            iter->Next();
         }
+        delete iter;
     }
+    // the log goes over the level files, except where a newer memtable was flushed already
+    ReplayWal();
+    // prefetch the blocks hot before the restart while serving
+    cache_warmer_->Start();
+    memory_governor_->Start();
 }
 } // namespace rangedb
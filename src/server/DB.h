@@ -1,9 +1,15 @@
 #pragma once
 #include "coro/coro.hpp"
+#include "db/Options.h"
+#include "db/WriteBatch.h"
+#include "db/cache/RowCache.h"
 #include "db/index/HashTable.h"
 #include "db/index/MemRangeVector.h"
 #include "db/index/RingHashVec.h"
+#include "db/mem/MemoryGovernor.h"
 #include "storage/FileManager.h"
+#include "storage/block/BlockCacheWarmer.h"
+#include "storage/block/BlockIOSchedual.h"
 #include "storage/block/BlockManager.h"
 #include "storage/compaction/CompactionManager.h"
 #include "storage/walblock/WalManager.h"
@@ -14,18 +20,33 @@
 namespace rangedb {
 class DB {
 private:
+    DBOptions options_;
     RingHashVec *mem_vector_;
     FileManager *file_manager_;
     BlockManagerPtr block_manager_;
+    BlockIOSchedual *io_schedual_;
+    BlockCacheWarmer *cache_warmer_;
+    // decoded values of hot keys, nullptr if disabled
+    RowCache *row_cache_;
+    db::MemoryGovernor *memory_governor_;
     WalManagerPtr wal_manager_;
-    std::thread wal_put_thread_;
     LsmTable *lsm_table_;
     moodycamel::BlockingConcurrentQueue<Task *> wal_queue_;
     ManifestPtr manifest_ptr_;
     CompactionManager compaction_manager_;
     /* data */
+
+    // Read the record source points to without loading its whole block
+    Status ReadRecord(storage::BlockFilePtr block_file, Slice *source);
+
+    // Register the index, the memtables and the caches with the memory governor
+    void InitMemoryGovernor();
+
+    // Hand the wal block files of the manifest to the memtables and index their records
+    void ReplayWal();
+
 public:
-    DB(/* args */);
+    DB(const DBOptions &options = DBOptions());
     ~DB();
     void Apply(Task *task);
 
@@ -33,7 +54,22 @@ public:
 
     Status Get(Slice *source);
 
-    Status Put(Slice *source);
+    // Same as Get, but a block cache miss is handed to the io scheduler and the
+    // caller is suspended until the block is loaded instead of blocking the thread.
+    coro::task<Status> AsyncGet(Slice *source);
+
+    Status Put(Slice *source, const WriteOptions &options = WriteOptions());
+
+    // Same as Put, but a synced write suspends the caller until the syncer has
+    // synced its record instead of blocking the thread on the fdatasync.
+    coro::task<Status> AsyncPut(Slice *source, WriteOptions options = WriteOptions());
+
+    // Apply the puts of batch as one unit, see WriteBatch: a restart recovers all of them or
+    // none, and a Get finds none of them until it finds all of them
+    Status Write(WriteBatch *batch, const WriteOptions &options = WriteOptions());
+
+    // Same as Write, but a synced write suspends the caller as AsyncPut does
+    coro::task<Status> AsyncWrite(WriteBatch *batch, WriteOptions options = WriteOptions());
 
     void FlushWal();
 
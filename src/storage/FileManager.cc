@@ -2,6 +2,7 @@
 #include "storage/sstblock/SstBlockFile.h"
 #include "utils/Manifest.h"
 #include "utils/Slice.h"
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <vector>
@@ -12,31 +13,68 @@ FileManager *FileManager::instance_ = nullptr;
 FileManager::FileManager(/* args */) {}
 FileManager::~FileManager() {}
 
-FileHandlePtr FileManager::CreateFile(const std::string &filename) {
-    FileHandlePtr file_handle = std::make_shared<FileHandle>(filename);
+FileHandlePtr FileManager::CreateFile(const std::string &filename, bool direct_io) {
+    FileHandlePtr file_handle = std::make_shared<FileHandle>(filename, direct_io);
     file_handle->Open();
     return file_handle;
 }
 
 storage::BlockFilePtr FileManager::GetBlockFile(uint32_t file_id) {
-    if (block_files_.find(file_id) == block_files_.end()) {
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto it = block_files_.find(file_id);
+        if (it != block_files_.end()) {
+            return it->second;
+        }
         if (file_infos_.find(file_id) == file_infos_.end()) {
             return nullptr;
         }
-        FileInfo *file_info = file_infos_[file_id];
-        storage::BlockFilePtr block_file;
-        block_file = std::make_shared<storage::SstBlockFile>(file_id);
-        block_files_[file_id] = block_file;
     }
-    return block_files_[file_id];
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    return GetBlockFileLocked(file_id);
+}
+
+storage::BlockFilePtr FileManager::GetBlockFileLocked(uint32_t file_id) {
+    auto it = block_files_.find(file_id);
+    if (it != block_files_.end()) {
+        return it->second;
+    }
+    // removed meanwhile
+    if (file_infos_.find(file_id) == file_infos_.end()) {
+        return nullptr;
+    }
+    storage::BlockFilePtr block_file = std::make_shared<storage::SstBlockFile>(file_id);
+    block_files_[file_id] = block_file;
+    return block_file;
 }
 
 void FileManager::AddBlockFile(uint64_t file_id, storage::BlockFilePtr block_file) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
     block_files_[file_id] = block_file;
     std::cout << "block file size: " << block_files_.size() << std::endl;
 }
 
+void FileManager::RemoveBlockFile(uint64_t file_id) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    block_files_.erase(file_id);
+    auto it = file_infos_.find(file_id);
+    if (it == file_infos_.end()) {
+        return;
+    }
+    // a list GetLevelFile returned may still hold the file info, it is not freed
+    FileInfo *file_info = it->second;
+    file_infos_.erase(it);
+    if (file_info->level < sst_file_range_.size()) {
+        std::vector<FileInfo *> &level_files = sst_file_range_[file_info->level];
+        level_files.erase(std::remove(level_files.begin(), level_files.end(), file_info), level_files.end());
+    }
+}
+
 storage::BlockFilePtr FileManager::BinaryRangeSearch(const ByteKey &key, int level) {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    if (sst_file_range_.size() <= level) {
+        return nullptr;
+    }
     int left = 0;
     int mid = 0;
     std::vector<FileInfo *> &file_infos = sst_file_range_[level];
@@ -46,7 +84,9 @@ storage::BlockFilePtr FileManager::BinaryRangeSearch(const ByteKey &key, int lev
         ByteKey mid_min_key = file_infos[mid]->min_key_;
         ByteKey mid_max_key = file_infos[mid]->max_key_;
         if (key >= mid_min_key && key < mid_max_key) {
-            return GetBlockFile(file_infos[mid]->file_id_);
+            uint64_t file_id = file_infos[mid]->file_id_;
+            lock.unlock();
+            return GetBlockFile(file_id);
         } else if (key < mid_min_key) {
             right = mid;
         } else if (key >= mid_max_key) {
@@ -57,6 +97,7 @@ storage::BlockFilePtr FileManager::BinaryRangeSearch(const ByteKey &key, int lev
 }
 
 void FileManager::GetLevelFile(int level, std::list<FileInfo *> *file_lst) {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
     if (sst_file_range_.size() <= level) {
         return;
     }
@@ -67,23 +108,29 @@ void FileManager::GetLevelFile(int level, std::list<FileInfo *> *file_lst) {
 
 void FileManager::InitBlockFile(std::vector<FileInfo> &file_infos) {
     for (auto &file_info : file_infos) {
+        if (file_info.status == 1) {
+            continue;
+        }
         storage::BlockFilePtr block_file;
         if (file_info.level == 0) {
-            block_file = std::make_shared<WalBlockFile>(file_info.file_id_);
-            size_t size = storage::SST_BLOCKFILE_HEADER_SIZE + 8 * 1024 * storage::BLOCK_SIZE;
-            int8_t *data = new int8_t[size];
-            FileHandlePtr file_handle = CreateFile(std::to_string(file_info.file_id_) + ".wal");
-            file_handle->Read(data, size, 0);
-            block_file->InitFromData(data);
+            auto wal_block_file = std::make_shared<WalBlockFile>(file_info.file_id_);
+            Status status = wal_block_file->Load();
+            if (!status.ok()) {
+                std::cout << "load wal block file " << file_info.file_id_ << " failed: " << status.ToString() << std::endl;
+                continue;
+            }
+            block_file = wal_block_file;
         } else {
             block_file = std::make_shared<storage::SstBlockFile>(file_info.file_id_);
         }
-        block_files_[file_info.file_id_] = block_file;
-        AddFileInfo(file_info.file_id_, file_info.level, &file_info);
+        AddBlockFile(file_info.file_id_, block_file);
+        // file_infos goes away with the caller
+        AddFileInfo(file_info.file_id_, file_info.level, new FileInfo(file_info));
     }
 }
 
 void FileManager::AddFileInfo(uint64_t file_id, int level, FileInfo *file_info) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
     file_infos_[file_info->file_id_] = file_info;
     if (sst_file_range_.size() <= level) {
         sst_file_range_.resize(level + 1);
@@ -4,26 +4,34 @@
 #include "utils/Manifest.h"
 #include <cstdint>
 #include <list>
+#include <shared_mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 namespace rangedb {
+// FileManager is shared by the readers, the io workers, the cache warmer and the flush
+// threads, every accessor takes mutex_
 class FileManager {
 private:
     /* data */
+    // guards file_infos_, block_files_ and sst_file_range_
+    std::shared_mutex mutex_;
     std::unordered_map<uint32_t, FileInfo *> file_infos_;
     std::unordered_map<uint32_t, storage::BlockFilePtr> block_files_;
     std::vector<std::vector<FileInfo *>> sst_file_range_;
     ManifestPtr manifest_ptr_;
     static FileManager *instance_;
 
+    // GetBlockFile under the exclusive mutex_, opens the sst file of a file info on a miss
+    storage::BlockFilePtr GetBlockFileLocked(uint32_t file_id);
+
 public:
     FileManager(/* args */);
 
     ~FileManager();
 
-    FileHandlePtr CreateFile(const std::string &filename);
+    FileHandlePtr CreateFile(const std::string &filename, bool direct_io = false);
 
     void OpenFile(const std::string &file_name);
 
@@ -41,6 +49,9 @@ public:
 
     void AddBlockFile(uint64_t file_id, storage::BlockFilePtr block_file);
 
+    // Forget the block file and the file info of file_id, GetBlockFile no longer finds it
+    void RemoveBlockFile(uint64_t file_id);
+
     void AddFileInfo(uint64_t file_id, int level, FileInfo *file_info);
 
     void AddLevelFile(int level);
@@ -4,8 +4,10 @@
 #include <cstring>
 #include <unistd.h>
 
+#include "utils/AlignedBufferPool.h"
 #include "utils/Comparator.h"
 #include "utils/Iterator.h"
+#include "utils/NoDestructor.h"
 #include "utils/Slice.h"
 
 namespace rangedb {
@@ -15,6 +17,34 @@ const size_t BLOCK_SIZE = 64 * 1024;
 const size_t SST_BLOCKFILE_HEADER_SIZE = 1024 * 1024;
 const size_t HEAD_SIZE = 8;
 const size_t MAX_BLOCK_NUM = 4 * 1024;
+// sst files bypass the page cache, the block cache is the only cache of sst blocks
+const bool SST_DIRECT_IO = true;
+// point lookups that miss the block cache read only the 4KB pages holding the record
+const bool SST_PARTIAL_READ = true;
+// the block and record caches are split into 2^BLOCK_CACHE_SHARD_BITS shards
+const uint32_t BLOCK_CACHE_SHARD_BITS = 6;
+// default memory budget of the block cache in bytes
+const size_t BLOCK_CACHE_CAPACITY = 1024 * 1024 * 1024;
+// default memory budget of the lz4 compressed second tier of the block cache, 0 disables it
+const size_t COMPRESSED_BLOCK_CACHE_CAPACITY = 256 * 1024 * 1024;
+// default size of the flash cache file in bytes
+const size_t FLASH_CACHE_CAPACITY = 32ULL * 1024 * 1024 * 1024;
+// the hottest block ids of the block cache are dumped to this file and prefetched after a restart
+const char *const BLOCK_CACHE_DUMP_FILE = "block_cache.hot";
+const uint64_t BLOCK_CACHE_DUMP_INTERVAL_MS = 60 * 1000;
+const size_t BLOCK_CACHE_DUMP_MAX_NUM = 64 * 1024;
+// io budget of the warm-up prefetch, foreground reads keep the rest of the device
+const size_t BLOCK_CACHE_PREFETCH_BYTES_PER_SEC = 64 * 1024 * 1024;
+// default memory budget of the record cache of partial reads in bytes
+const size_t RECORD_CACHE_CAPACITY = 16 * 1024 * 1024;
+// number of released block buffers kept for reuse
+const size_t BLOCK_BUFFER_POOL_SIZE = 1024;
+
+// Shared pool of BLOCK_SIZE buffers, every sst block owns one of them
+inline AlignedBufferPool *BlockBufferPool() {
+    static NoDestructor<AlignedBufferPool> pool(BLOCK_SIZE, BLOCK_BUFFER_POOL_SIZE);
+    return pool.get();
+}
 
 struct BlockHeader {
     uint32_t offset_;
@@ -36,6 +66,8 @@ public:
     virtual void Finshed() = 0;
     virtual const int8_t *GetData() const = 0;
     virtual void InitFromData(int8_t *data) = 0;
+    // Memory held by the block, charged against the block cache budget
+    virtual size_t GetCharge() const { return BLOCK_SIZE; }
     virtual Iterator *NewIterator(const Comparator *comparator) = 0;
 };
 
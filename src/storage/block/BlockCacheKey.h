@@ -0,0 +1,27 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace rangedb {
+// (file_id, block_id) packed into one integer, no allocation on the lookup path
+using BlockCacheKey = unsigned __int128;
+
+inline BlockCacheKey MakeBlockCacheKey(uint64_t high, uint64_t low) { return (BlockCacheKey)high << 64 | low; }
+
+inline uint64_t BlockCacheKeyHigh(BlockCacheKey key) { return (uint64_t)(key >> 64); }
+
+inline uint64_t BlockCacheKeyLow(BlockCacheKey key) { return (uint64_t)key; }
+
+struct BlockCacheKeyHash {
+    size_t operator()(const BlockCacheKey &key) const {
+        uint64_t hash = BlockCacheKeyHigh(key) * 0x9E3779B97F4A7C15ULL ^ BlockCacheKeyLow(key);
+        // murmur3 finalizer
+        hash ^= hash >> 33;
+        hash *= 0xFF51AFD7ED558CCDULL;
+        hash ^= hash >> 33;
+        hash *= 0xC4CEB9FE1A85EC53ULL;
+        hash ^= hash >> 33;
+        return hash;
+    }
+};
+} // namespace rangedb
@@ -0,0 +1,160 @@
+#include "storage/block/BlockCacheWarmer.h"
+#include "storage/FileManager.h"
+#include "storage/block/BlockManager.h"
+#include "storage/sstblock/SstBlockFile.h"
+#include "utils/FileHandle.h"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+namespace rangedb {
+
+const uint64_t BLOCK_CACHE_DUMP_MAGIC = 0x424c4f434b484f54; // "BLOCKHOT"
+
+BlockCacheWarmer::BlockCacheWarmer(const std::string &path, uint64_t dump_interval_ms, size_t bytes_per_sec, size_t max_dump_num)
+    : path_(path), dump_interval_ms_(dump_interval_ms), bytes_per_sec_(bytes_per_sec), max_dump_num_(max_dump_num), prefetched_num_(0),
+      prefetch_done_(false), stop_(true) {}
+
+BlockCacheWarmer::~BlockCacheWarmer() { Stop(); }
+
+void BlockCacheWarmer::Start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!stop_) {
+        return;
+    }
+    stop_ = false;
+    prefetch_done_ = false;
+    thread_ = std::thread([this]() { Run(); });
+}
+
+void BlockCacheWarmer::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stop_) {
+            return;
+        }
+        stop_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+    Status status = Dump();
+    if (!status.ok()) {
+        std::cout << "dump block cache failed: " << status.ToString() << std::endl;
+    }
+}
+
+void BlockCacheWarmer::WaitForPrefetch() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]() { return prefetch_done_ || stop_; });
+}
+
+// dump file layout: magic, number of blocks, then file id and block id of every block
+Status BlockCacheWarmer::Dump() {
+    std::vector<BlockCacheKey> keys = BlockManager::GetInstance()->GetHotBlocks(max_dump_num_);
+    std::string buffer;
+    uint64_t num = keys.size();
+    buffer.reserve(sizeof(uint64_t) * 2 + num * sizeof(uint64_t) * 2);
+    buffer.append((const char *)&BLOCK_CACHE_DUMP_MAGIC, sizeof(BLOCK_CACHE_DUMP_MAGIC));
+    buffer.append((const char *)&num, sizeof(num));
+    for (auto key : keys) {
+        uint64_t file_id = BlockCacheKeyHigh(key);
+        uint64_t block_id = BlockCacheKeyLow(key);
+        buffer.append((const char *)&file_id, sizeof(file_id));
+        buffer.append((const char *)&block_id, sizeof(block_id));
+    }
+    // a crash while dumping keeps the previous dump
+    std::string tmp_path = path_ + ".tmp";
+    unlink(tmp_path.c_str());
+    FileHandle file_handle(tmp_path);
+    if (!file_handle.Open() || !file_handle.WriteAt(buffer.data(), buffer.size(), 0)) {
+        return Status(DB_ERROR, "write block cache dump failed");
+    }
+    file_handle.Sync();
+    file_handle.Close();
+    if (rename(tmp_path.c_str(), path_.c_str()) != 0) {
+        return Status(DB_ERROR, "rename block cache dump failed");
+    }
+    return Status::OK();
+}
+
+Status BlockCacheWarmer::Load(std::vector<BlockCacheKey> *keys) {
+    if (access(path_.c_str(), F_OK) != 0) {
+        return Status(DB_NOT_FOUND, "no block cache dump");
+    }
+    FileHandle file_handle(path_);
+    if (!file_handle.Open()) {
+        return Status(DB_ERROR, "open block cache dump failed");
+    }
+    uint64_t header[2] = {0, 0};
+    if (!file_handle.Read(header, sizeof(header), 0) || header[0] != BLOCK_CACHE_DUMP_MAGIC) {
+        file_handle.Close();
+        return Status(DB_ERROR, "invalid block cache dump");
+    }
+    std::vector<uint64_t> ids(std::min<uint64_t>(header[1], max_dump_num_) * 2);
+    bool ok = ids.empty() || file_handle.Read(ids.data(), ids.size() * sizeof(uint64_t), sizeof(header));
+    file_handle.Close();
+    if (!ok) {
+        return Status(DB_ERROR, "truncated block cache dump");
+    }
+    keys->reserve(ids.size() / 2);
+    for (size_t i = 0; i < ids.size(); i += 2) {
+        keys->push_back(MakeBlockCacheKey(ids[i], ids[i + 1]));
+    }
+    return Status::OK();
+}
+
+bool BlockCacheWarmer::WaitFor(uint64_t ms) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return !cv_.wait_for(lock, std::chrono::milliseconds(ms), [this]() { return stop_; });
+}
+
+void BlockCacheWarmer::Prefetch(const std::vector<BlockCacheKey> &keys) {
+    BlockManagerPtr block_manager = BlockManager::GetInstance();
+    FileManager *file_manager = FileManager::GetInstance();
+    auto start = std::chrono::steady_clock::now();
+    size_t read_bytes = 0;
+    for (auto key : keys) {
+        uint64_t file_id = BlockCacheKeyHigh(key);
+        uint64_t block_id = BlockCacheKeyLow(key);
+        if (block_manager->IsBlockCached(file_id, block_id)) {
+            continue;
+        }
+        // the file may have been compacted away since the dump
+        auto sst_file = std::dynamic_pointer_cast<storage::SstBlockFile>(file_manager->GetBlockFile(file_id));
+        if (sst_file == nullptr || sst_file->GetBlock(block_id, CacheHint::NORMAL) == nullptr) {
+            continue;
+        }
+        prefetched_num_.fetch_add(1, std::memory_order_relaxed);
+        read_bytes += storage::BLOCK_SIZE;
+        // stay under bytes_per_sec_ on average since the prefetch started
+        uint64_t expect_ms = read_bytes * 1000 / bytes_per_sec_;
+        uint64_t elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        if (expect_ms > elapsed_ms && !WaitFor(expect_ms - elapsed_ms)) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stop_) {
+            return;
+        }
+    }
+}
+
+void BlockCacheWarmer::Run() {
+    std::vector<BlockCacheKey> keys;
+    if (Load(&keys).ok()) {
+        Prefetch(keys);
+        std::cout << "block cache warm-up prefetched " << prefetched_num_.load() << " of " << keys.size() << " blocks" << std::endl;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        prefetch_done_ = true;
+    }
+    cv_.notify_all();
+    while (WaitFor(dump_interval_ms_)) {
+        Status status = Dump();
+        if (!status.ok()) {
+            std::cout << "dump block cache failed: " << status.ToString() << std::endl;
+        }
+    }
+}
+} // namespace rangedb
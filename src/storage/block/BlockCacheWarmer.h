@@ -0,0 +1,62 @@
+#pragma once
+#include "storage/block/Block.h"
+#include "storage/block/BlockCacheKey.h"
+#include "utils/Status.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace rangedb {
+// BlockCacheWarmer keeps the block cache warm across restarts. The ids of the
+// hottest cached blocks are dumped to a file every dump_interval_ms and on Stop.
+// Start loads the last dump and prefetches the blocks in the background, hottest
+// first, reading at most bytes_per_sec so the foreground reads are not starved.
+// Blocks already cached and blocks of files removed since the dump are skipped.
+class BlockCacheWarmer {
+public:
+    BlockCacheWarmer(const std::string &path, uint64_t dump_interval_ms = storage::BLOCK_CACHE_DUMP_INTERVAL_MS,
+                     size_t bytes_per_sec = storage::BLOCK_CACHE_PREFETCH_BYTES_PER_SEC,
+                     size_t max_dump_num = storage::BLOCK_CACHE_DUMP_MAX_NUM);
+    ~BlockCacheWarmer();
+
+    // Start the prefetch and the periodic dump
+    void Start();
+
+    // Stop the background thread and dump the hottest blocks one last time
+    void Stop();
+
+    // Write the ids of the hottest cached blocks to the dump file
+    Status Dump();
+
+    // Read the block ids of the dump file, hottest first
+    Status Load(std::vector<BlockCacheKey> *keys);
+
+    // Blocks read from disk by the prefetch
+    size_t GetPrefetchedNum() const { return prefetched_num_.load(); }
+
+    // Wait until the prefetch of the last dump is done
+    void WaitForPrefetch();
+
+private:
+    void Run();
+    void Prefetch(const std::vector<BlockCacheKey> &keys);
+    // Sleep for ms or until Stop, returns false if stopped
+    bool WaitFor(uint64_t ms);
+
+    std::string path_;
+    uint64_t dump_interval_ms_;
+    size_t bytes_per_sec_;
+    size_t max_dump_num_;
+    std::atomic<size_t> prefetched_num_;
+    bool prefetch_done_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_;
+    std::thread thread_;
+};
+} // namespace rangedb
@@ -0,0 +1,89 @@
+#pragma once
+#include "storage/block/Block.h"
+#include "utils/Epoch.h"
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace rangedb {
+namespace storage {
+// BlockHandle is a pinned reference to a block. A block found in the block
+// cache is pinned by the reader's epoch and referenced by a raw pointer, so a
+// hot block is not a shared refcount every reader thread writes to; the cache
+// retires evicted blocks to the epoch manager, the block outlives the handle.
+// A block loaded from a lower tier or the disk is owned by the handle.
+// Handles are meant to live for one lookup, do not keep them across blocking
+// calls or co_await, a pinned epoch holds back the release of every retired block.
+class BlockHandle {
+public:
+    BlockHandle() : epoch_(nullptr), block_(nullptr) {}
+
+    // block was looked up inside the epoch the caller entered, the handle exits it
+    BlockHandle(EpochManager *epoch, Block *block) : epoch_(epoch), block_(block) {}
+
+    explicit BlockHandle(BlockPtr block) : epoch_(nullptr), block_(block.get()), owned_(std::move(block)) {}
+
+    ~BlockHandle() { Reset(); }
+
+    BlockHandle(BlockHandle &&other) noexcept : epoch_(other.epoch_), block_(other.block_), owned_(std::move(other.owned_)) {
+        other.epoch_ = nullptr;
+        other.block_ = nullptr;
+    }
+
+    BlockHandle &operator=(BlockHandle &&other) noexcept {
+        if (this != &other) {
+            Reset();
+            epoch_ = other.epoch_;
+            block_ = other.block_;
+            owned_ = std::move(other.owned_);
+            other.epoch_ = nullptr;
+            other.block_ = nullptr;
+        }
+        return *this;
+    }
+
+    BlockHandle(const BlockHandle &) = delete;
+    BlockHandle &operator=(const BlockHandle &) = delete;
+
+    inline Block *Get() const { return block_; }
+
+    inline Block *operator->() const { return block_; }
+
+    inline explicit operator bool() const { return block_ != nullptr; }
+
+    inline bool operator==(std::nullptr_t) const { return block_ == nullptr; }
+
+    inline bool operator!=(std::nullptr_t) const { return block_ != nullptr; }
+
+    // true if the block is pinned by an epoch rather than owned
+    inline bool IsPinned() const { return epoch_ != nullptr; }
+
+    // Keep the value a Read of the block left in source alive once the handle is gone: an owned
+    // block is shared with source, the value of a pinned one is copied out, so the epoch is
+    // still left with the lookup
+    void HoldValue(Slice *source) const {
+        if (owned_ != nullptr) {
+            source->data_holder_ = owned_;
+            return;
+        }
+        auto value = std::make_shared<const std::string>(source->data_.data(), source->data_.size());
+        source->data_ = resp::buffer(value->data(), value->size());
+        source->data_holder_ = value;
+    }
+
+    void Reset() {
+        if (epoch_ != nullptr) {
+            epoch_->Exit();
+            epoch_ = nullptr;
+        }
+        block_ = nullptr;
+        owned_ = nullptr;
+    }
+
+private:
+    EpochManager *epoch_;
+    Block *block_;
+    BlockPtr owned_;
+};
+} // namespace storage
+} // namespace rangedb
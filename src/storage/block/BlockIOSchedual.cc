@@ -1,17 +1,184 @@
+// linux/fs.h from liburing defines a BLOCK_SIZE macro which clashes with storage::BLOCK_SIZE
+#include <liburing.h>
+#undef BLOCK_SIZE
+
 #include "storage/block/BlockIOSchedual.h"
 #include "storage/block/Block.h"
+#include "storage/sstblock/SstBlock.h"
+#include "storage/sstblock/SstBlockFile.h"
+#include <cerrno>
 
 namespace rangedb {
-BlockIOSchedual::BlockIOSchedual(/* args */) {}
-void BlockIOSchedual::ReadBlock(const std::string &filename, size_t block_id) {
-    storage::BlockPtr block = nullptr;
-    if (filename.find(".wal") != std::string::npos) {
-        // WalBlockFile block_file(filename.c_str());
-        // block_manager_->ReadBlock(filename, block_id);
-        // uint64_t inner_block_id = block_id - std::stoi(filename.substr(0, filename.find(".")));
-        // block = block_file->ReadBlock(inner_block_id);
-    }
-    // block_manager_->AddBlockCache(block_id, block);
-    //  Read block from disk
-}
-} // namespace rangedb
\ No newline at end of file
+BlockIOSchedual *BlockIOSchedual::instance_ = nullptr;
+
+BlockIOSchedual::BlockIOSchedual(uint32_t worker_num) : stop_(false), coalesced_num_(0), read_num_(0) {
+    block_manager_ = BlockManager::GetInstance();
+    file_manager_ = FileManager::GetInstance();
+    for (uint32_t i = 0; i < worker_num; i++) {
+        IOWorker *worker = new IOWorker();
+        worker->ring_ = new struct io_uring();
+        int ret = io_uring_queue_init(IO_URING_QUEUE_DEPTH, worker->ring_, 0);
+        if (ret < 0) {
+            std::cout << "io_uring init failed, errno: " << -ret << std::endl;
+            delete worker->ring_;
+            delete worker;
+            continue;
+        }
+        worker->thread_ = std::thread([this, worker]() { Run(worker); });
+        workers_.emplace_back(worker);
+    }
+}
+
+BlockIOSchedual::~BlockIOSchedual() { Stop(); }
+
+void BlockIOSchedual::Stop() {
+    if (stop_.exchange(true)) {
+        return;
+    }
+    for (auto worker : workers_) {
+        worker->thread_.join();
+        io_uring_queue_exit(worker->ring_);
+        delete worker->ring_;
+        delete worker;
+    }
+    workers_.clear();
+}
+
+bool BlockIOSchedual::ReadBlock(Task *task) {
+    if (workers_.empty() || stop_.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    BlockCacheKey key = TaskKey(task);
+    task->done_ = false;
+    task->action_ = TaskType::GET_FROM_DISK;
+    {
+        std::lock_guard<std::mutex> lock(inflight_mutex_);
+        auto it = inflight_.find(key);
+        if (it != inflight_.end()) {
+            it->second.push_back(task);
+            coalesced_num_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        inflight_[key].push_back(task);
+    }
+    // requests for the same block always land on the same ring
+    IOWorker *worker = workers_[BlockCacheKeyHash()(key) % workers_.size()];
+    if (!worker->task_queue_.enqueue(task)) {
+        Finish(key, -EBUSY);
+        return false;
+    }
+    return true;
+}
+
+void BlockIOSchedual::Finish(BlockCacheKey key, int result) {
+    std::vector<Task *> tasks;
+    {
+        std::lock_guard<std::mutex> lock(inflight_mutex_);
+        auto it = inflight_.find(key);
+        if (it == inflight_.end()) {
+            return;
+        }
+        tasks.swap(it->second);
+        inflight_.erase(it);
+    }
+    for (auto task : tasks) {
+        task->io_result_ = result;
+        task->done_ = true;
+        task->event_.set();
+    }
+}
+
+bool BlockIOSchedual::Submit(IOWorker *worker, Task *task) {
+    Slice *source = task->slice_;
+    IORequest *request = new IORequest{task, source->file_id_, source->block_id_, nullptr};
+    auto sst_file = std::dynamic_pointer_cast<storage::SstBlockFile>(file_manager_->GetBlockFile(source->file_id_));
+    if (sst_file == nullptr) {
+        Complete(request, -ENOENT);
+        return false;
+    }
+    struct io_uring_sqe *sqe = io_uring_get_sqe(worker->ring_);
+    if (sqe == nullptr) {
+        Complete(request, -EBUSY);
+        return false;
+    }
+    request->buffer_ = storage::BlockBufferPool()->Allocate();
+    io_uring_prep_read(sqe, sst_file->GetFileHandle()->GetFd(), request->buffer_, storage::BLOCK_SIZE,
+                       storage::SstBlockFile::GetBlockOffset(request->block_id_));
+    io_uring_sqe_set_data(sqe, request);
+    worker->inflight_++;
+    read_num_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void BlockIOSchedual::Complete(IORequest *request, int result) {
+    BlockCacheKey key = MakeBlockCacheKey(request->file_id_, request->block_id_);
+    if (result == (int)storage::BLOCK_SIZE) {
+        auto block = std::make_shared<storage::SstBlock>(request->block_id_);
+        block->InitFromData(request->buffer_);
+        block_manager_->AddBlockCache(request->file_id_, request->block_id_, block);
+    } else {
+        storage::BlockBufferPool()->Release(request->buffer_);
+    }
+    delete request;
+    // the block is cached before any waiter is resumed
+    Finish(key, result);
+}
+
+void BlockIOSchedual::Reap(IOWorker *worker) {
+    if (worker->inflight_ == 0) {
+        return;
+    }
+    struct io_uring_cqe *cqe = nullptr;
+    struct __kernel_timespec timeout = {0, 100 * 1000};
+    if (io_uring_wait_cqe_timeout(worker->ring_, &cqe, &timeout) < 0) {
+        return;
+    }
+    while (cqe != nullptr) {
+        IORequest *request = static_cast<IORequest *>(io_uring_cqe_get_data(cqe));
+        int result = cqe->res;
+        io_uring_cqe_seen(worker->ring_, cqe);
+        worker->inflight_--;
+        Complete(request, result);
+        cqe = nullptr;
+        if (io_uring_peek_cqe(worker->ring_, &cqe) < 0) {
+            break;
+        }
+    }
+}
+
+void BlockIOSchedual::Run(IOWorker *worker) {
+    Task *tasks[IO_URING_QUEUE_DEPTH];
+    while (!stop_.load(std::memory_order_relaxed) || worker->inflight_ > 0) {
+        size_t free_slot = IO_URING_QUEUE_DEPTH - worker->inflight_;
+        size_t count = 0;
+        if (worker->inflight_ == 0) {
+            // idle, block on the queue but wake up now and then to check stop_
+            count = worker->task_queue_.wait_dequeue_bulk_timed(tasks, free_slot, 1000);
+        } else if (free_slot > 0) {
+            count = worker->task_queue_.try_dequeue_bulk(tasks, free_slot);
+        }
+        size_t submitted = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (Submit(worker, tasks[i])) {
+                submitted++;
+            }
+        }
+        if (submitted > 0) {
+            io_uring_submit(worker->ring_);
+        }
+        Reap(worker);
+    }
+    // wake up whoever is still waiting on a request that never made it to the ring
+    Task *task = nullptr;
+    while (worker->task_queue_.try_dequeue(task)) {
+        Finish(TaskKey(task), -ECANCELED);
+    }
+}
+
+BlockIOSchedual *BlockIOSchedual::GetInstance() {
+    if (instance_ == nullptr) {
+        instance_ = new BlockIOSchedual();
+    }
+    return instance_;
+}
+} // namespace rangedb
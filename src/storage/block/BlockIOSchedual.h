@@ -1,15 +1,70 @@
 #pragma once
+#include "concurrentqueue/blockingconcurrentqueue.h"
 #include "storage/FileManager.h"
+#include "storage/block/BlockCacheKey.h"
 #include "storage/block/BlockManager.h"
+#include "utils/Task.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+struct io_uring;
 namespace rangedb {
+const uint32_t IO_URING_QUEUE_DEPTH = 256;
+const uint32_t IO_WORKER_NUM = 4;
+
+// BlockIOSchedual turns block cache misses into asynchronous reads. Every worker
+// owns one io_uring instance and one task queue, a Task submitted by ReadBlock is
+// read into a new block, added to the block cache and then task->event_ is set so
+// the coroutine that co_await it is resumed. The waiting coroutine is resumed on
+// the io worker thread. Concurrent misses on the same block are coalesced, only
+// the first one is read and the later ones wait for its completion.
 class BlockIOSchedual {
 private:
+    struct IORequest {
+        Task *task_;
+        uint64_t file_id_;
+        uint32_t block_id_;
+        int8_t *buffer_;
+    };
+    struct IOWorker {
+        struct io_uring *ring_;
+        moodycamel::BlockingConcurrentQueue<Task *> task_queue_;
+        std::thread thread_;
+        uint32_t inflight_ = 0;
+    };
     BlockManagerPtr block_manager_;
-    FileManagerPtr file_manager_;
-    /* data */
+    FileManager *file_manager_;
+    std::vector<IOWorker *> workers_;
+    std::atomic<bool> stop_;
+    // tasks waiting for a block being read, the first one is the one queued to a worker
+    std::mutex inflight_mutex_;
+    std::unordered_map<BlockCacheKey, std::vector<Task *>, BlockCacheKeyHash> inflight_;
+    std::atomic<uint64_t> coalesced_num_;
+    std::atomic<uint64_t> read_num_;
+    static BlockIOSchedual *instance_;
+
+    void Run(IOWorker *worker);
+    bool Submit(IOWorker *worker, Task *task);
+    void Complete(IORequest *request, int result);
+    void Reap(IOWorker *worker);
+    // Wake up every task waiting for key with result
+    void Finish(BlockCacheKey key, int result);
+    static inline BlockCacheKey TaskKey(const Task *task) { return MakeBlockCacheKey(task->slice_->file_id_, task->slice_->block_id_); }
+
 public:
-    BlockIOSchedual(/* args */);
+    BlockIOSchedual(uint32_t worker_num = IO_WORKER_NUM);
     ~BlockIOSchedual();
-    void ReadBlock(const std::string &file_name, size_t offset);
+    // Queue an async read of the block task->slice_ points to. Returns false if
+    // the request can not be queued, otherwise task->event_ is set once the read
+    // finished and task->io_result_ holds the read size or -errno.
+    bool ReadBlock(Task *task);
+    void Stop();
+    // Misses that waited for a read already in flight instead of issuing their own
+    uint64_t GetCoalescedNum() const { return coalesced_num_.load(); }
+    // Block reads submitted to the rings
+    uint64_t GetReadNum() const { return read_num_.load(); }
+    static BlockIOSchedual *GetInstance();
 };
 } // namespace rangedb
@@ -1,46 +1,103 @@
 #pragma once
 #include "storage/block/Block.h"
+#include "storage/block/BlockCacheKey.h"
+#include "storage/block/BlockHandle.h"
+#include "storage/block/CompressedBlockCache.h"
+#include "storage/block/FlashCache.h"
 #include "storage/walblock/WalBlockFile.h"
 #include "utils/CommonUtil.h"
-#include "utils/LruCache.h"
+#include "utils/ShardedCache.h"
 #include <cstdint>
+#include <string>
 namespace rangedb {
+// Raw bytes of one serialized record, filled by a partial read
+using RecordPtr = std::shared_ptr<std::string>;
+
 class BlockManager {
 private:
     /* data */
-    LruCache<std::string, storage::BlockPtr> block_cache_;
+    ShardedCache<BlockCacheKey, storage::BlockPtr, BlockCacheKeyHash> block_cache_;
+    // records read by partial reads, slices deserialized from them point into the cached bytes
+    ShardedCache<BlockCacheKey, RecordPtr, BlockCacheKeyHash> record_cache_;
+    // compressed blocks evicted from block_cache_, nullptr if disabled
+    std::unique_ptr<CompressedBlockCache> compressed_cache_;
+    // blocks evicted from block_cache_ persisted on a local fast device, nullptr if disabled
+    std::unique_ptr<FlashCache> flash_cache_;
     std::unordered_map<std::string, WalBlockFilePtr> wal_block_files_;
     // std::unordered_map<std::string, storage::SstBlockFilePtr> sst_block_files_level_map_;
     std::unordered_map<int, std::vector<std::string>> level_sst_file_map_;
     static std::shared_ptr<BlockManager> block_manager_instance;
 
+    // the file id is the high part as in the block keys, the inner block id and the offset
+    // in the block, both below 2^32, are the low part
+    static inline BlockCacheKey RecordCacheKey(uint64_t file_id, size_t block_id, uint64_t offset) {
+        return MakeBlockCacheKey(file_id, (uint64_t)block_id << 32 | (uint32_t)offset);
+    }
+
 public:
-    BlockManager(/* args */) : block_cache_(LruCache<std::string, storage::BlockPtr>(1024 * 1024)){};
+    // All capacities are budgets in bytes, a compressed_cache_capacity of 0 disables the compressed tier
+    BlockManager(size_t block_cache_capacity = storage::BLOCK_CACHE_CAPACITY, size_t record_cache_capacity = storage::RECORD_CACHE_CAPACITY,
+                 size_t compressed_cache_capacity = storage::COMPRESSED_BLOCK_CACHE_CAPACITY)
+        : block_cache_(block_cache_capacity, storage::BLOCK_CACHE_SHARD_BITS),
+          record_cache_(record_cache_capacity, storage::BLOCK_CACHE_SHARD_BITS) {
+        if (compressed_cache_capacity > 0) {
+            compressed_cache_ = std::make_unique<CompressedBlockCache>(compressed_cache_capacity, storage::BLOCK_CACHE_SHARD_BITS);
+        }
+        // readers of the block cache hold raw pointers pinned by their epoch, blocks leaving it are released by the epoch manager
+        block_cache_.SetRetireCallback([](storage::BlockPtr &&block) { EpochManager::GetInstance()->Retire(std::move(block)); });
+        block_cache_.SetEvictCallback([this](const BlockCacheKey &key, const storage::BlockPtr &block) {
+            if (compressed_cache_ != nullptr) {
+                compressed_cache_->Insert(key, block);
+            }
+            if (flash_cache_ != nullptr) {
+                flash_cache_->Insert(key, block);
+            }
+        });
+    };
     ~BlockManager(){};
     bool ReadBlock(Slice *source) {
         uint64_t block_id = source->block_id_;
         uint64_t file_id = source->file_id_;
-        std::string key = CommonUtil::Uint128ToString(file_id, block_id);
-        if (!block_cache_.exists(key)) {
+        storage::BlockPtr block = GetBlock(file_id, block_id);
+        if (block == nullptr) {
             return false;
         }
-        storage::BlockPtr block = nullptr;
-        bool exist = block_cache_.get(key, block);
         block->Read(source);
+        // the value points into the block, the cache may evict it meanwhile
+        source->data_holder_ = block;
         return true;
     }
 
     storage::BlockPtr GetBlock(uint64_t file_id, size_t block_id) {
         storage::BlockPtr block = nullptr;
-        std::string key = CommonUtil::Uint128ToString(file_id, block_id);
-
-        if (!block_cache_.exists(key)) {
-            return nullptr;
+        BlockCacheKey key = MakeBlockCacheKey(file_id, block_id);
+        if (block_cache_.Lookup(key, block)) {
+            return block;
+        }
+        if (compressed_cache_ != nullptr) {
+            block = compressed_cache_->Lookup(key);
+        }
+        if (block == nullptr && flash_cache_ != nullptr) {
+            block = flash_cache_->Lookup(key);
+        }
+        if (block != nullptr) {
+            block_cache_.Insert(key, block, block->GetCharge());
         }
-        block_cache_.get(key, block);
         return block;
     }
 
+    // Same as GetBlock, but a block cache hit is pinned by the reader's epoch instead of copying its shared_ptr
+    storage::BlockHandle PinBlock(uint64_t file_id, size_t block_id) {
+        EpochManager *epoch = EpochManager::GetInstance();
+        epoch->Enter();
+        storage::Block *block = nullptr;
+        if (block_cache_.LookupRaw(MakeBlockCacheKey(file_id, block_id), block)) {
+            return storage::BlockHandle(epoch, block);
+        }
+        epoch->Exit();
+        return storage::BlockHandle(GetBlock(file_id, block_id));
+    }
+
     bool ReadBlockFromDisk(const std::string &file_name, uint64_t file_id, size_t block_id) {
         storage::BlockPtr block = nullptr;
         if (file_name.find(".wal") != std::string::npos) {
@@ -53,11 +110,72 @@ public:
 
     bool WriteBlockToDisk(const std::string &file_name, size_t block_id) { return true; }
 
-    void AddBlockCache(uint64_t file_id, size_t block_id, storage::BlockPtr block) {
-        std::string key = CommonUtil::Uint128ToString(file_id, block_id);
-        block_cache_.put(key, block);
+    void AddBlockCache(uint64_t file_id, size_t block_id, storage::BlockPtr block, CacheHint hint = CacheHint::NORMAL) {
+        if (block == nullptr) {
+            return;
+        }
+        BlockCacheKey key = MakeBlockCacheKey(file_id, block_id);
+        if (compressed_cache_ != nullptr) {
+            // the new block replaces whatever was evicted under the same id
+            compressed_cache_->Erase(key);
+        }
+        if (flash_cache_ != nullptr) {
+            flash_cache_->Erase(key);
+        }
+        block_cache_.Insert(key, block, block->GetCharge(), hint);
+    }
+
+    RecordPtr GetRecord(uint64_t file_id, size_t block_id, uint64_t offset) {
+        RecordPtr record = nullptr;
+        BlockCacheKey key = RecordCacheKey(file_id, block_id, offset);
+        record_cache_.Lookup(key, record);
+        return record;
+    }
+
+    void AddRecordCache(uint64_t file_id, size_t block_id, uint64_t offset, RecordPtr record) {
+        BlockCacheKey key = RecordCacheKey(file_id, block_id, offset);
+        record_cache_.Insert(key, record, record->capacity() + sizeof(std::string));
+    }
+
+    void SetBlockCacheCapacity(size_t capacity) { block_cache_.SetCapacity(capacity); }
+
+    size_t GetBlockCacheUsage() { return block_cache_.GetUsage(); }
+
+    void SetRecordCacheCapacity(size_t capacity) { record_cache_.SetCapacity(capacity); }
+
+    size_t GetRecordCacheUsage() { return record_cache_.GetUsage(); }
+
+    bool HasCompressedCache() const { return compressed_cache_ != nullptr; }
+
+    void SetCompressedCacheCapacity(size_t capacity) {
+        if (compressed_cache_ != nullptr) {
+            compressed_cache_->SetCapacity(capacity);
+        }
+    }
+
+    size_t GetCompressedCacheUsage() { return compressed_cache_ != nullptr ? compressed_cache_->GetUsage() : 0; }
+
+    bool IsBlockCached(uint64_t file_id, size_t block_id) { return block_cache_.Exists(MakeBlockCacheKey(file_id, block_id)); }
+
+    // Keys of up to limit cached blocks, hottest first
+    std::vector<BlockCacheKey> GetHotBlocks(size_t limit) { return block_cache_.HotKeys(limit); }
+
+    CompressedBlockCacheStats GetCompressedCacheStats() {
+        return compressed_cache_ != nullptr ? compressed_cache_->GetStats() : CompressedBlockCacheStats{};
     }
 
+    // Open the flash tier in dir, call before the cache is shared between threads
+    Status EnableFlashCache(const std::string &dir, size_t capacity) {
+        auto flash_cache = std::make_unique<FlashCache>(dir, capacity);
+        Status status = flash_cache->Open();
+        if (status.ok()) {
+            flash_cache_ = std::move(flash_cache);
+        }
+        return status;
+    }
+
+    FlashCacheStats GetFlashCacheStats() { return flash_cache_ != nullptr ? flash_cache_->GetStats() : FlashCacheStats{}; }
+
     static std::shared_ptr<BlockManager> GetInstance();
 };
 using BlockManagerPtr = std::shared_ptr<BlockManager>;
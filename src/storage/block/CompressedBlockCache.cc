@@ -0,0 +1,64 @@
+#include "storage/block/CompressedBlockCache.h"
+#include "storage/sstblock/SstBlock.h"
+#include <lz4.h>
+
+namespace rangedb {
+
+// keep a block only if lz4 saves at least 1/8 of it
+const size_t COMPRESSED_BLOCK_MAX_SIZE = storage::BLOCK_SIZE - storage::BLOCK_SIZE / 8;
+
+CompressedBlockCache::CompressedBlockCache(size_t capacity, uint32_t shard_bits)
+    : cache_(capacity, shard_bits), hit_(0), miss_(0), insert_(0), reject_(0) {}
+
+bool CompressedBlockCache::Insert(BlockCacheKey key, const storage::BlockPtr &block) {
+    // only blocks read back from sst files, blocks still being built may change
+    auto sst_block = std::dynamic_pointer_cast<storage::SstBlock>(block);
+    if (sst_block == nullptr || !sst_block->IsSealed()) {
+        return false;
+    }
+    std::string buffer(COMPRESSED_BLOCK_MAX_SIZE, '\0');
+    int size = LZ4_compress_default((const char *)sst_block->GetData(), buffer.data(), storage::BLOCK_SIZE, buffer.size());
+    if (size <= 0) {
+        // does not fit in COMPRESSED_BLOCK_MAX_SIZE
+        reject_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    buffer.resize(size);
+    buffer.shrink_to_fit();
+    auto compressed = std::make_shared<std::string>(std::move(buffer));
+    cache_.Insert(key, compressed, compressed->capacity() + sizeof(std::string));
+    insert_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+storage::BlockPtr CompressedBlockCache::Lookup(BlockCacheKey key) {
+    std::shared_ptr<std::string> compressed;
+    if (!cache_.Lookup(key, compressed)) {
+        miss_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    int8_t *data = storage::BlockBufferPool()->Allocate();
+    int size = LZ4_decompress_safe(compressed->data(), (char *)data, compressed->size(), storage::BLOCK_SIZE);
+    if (size != (int)storage::BLOCK_SIZE) {
+        storage::BlockBufferPool()->Release(data);
+        cache_.Erase(key);
+        miss_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    auto block = std::make_shared<storage::SstBlock>(BlockCacheKeyLow(key));
+    block->InitFromData(data);
+    cache_.Erase(key);
+    hit_.fetch_add(1, std::memory_order_relaxed);
+    return block;
+}
+
+void CompressedBlockCache::Erase(BlockCacheKey key) { cache_.Erase(key); }
+
+void CompressedBlockCache::SetCapacity(size_t capacity) { cache_.SetCapacity(capacity); }
+
+size_t CompressedBlockCache::GetUsage() { return cache_.GetUsage(); }
+
+CompressedBlockCacheStats CompressedBlockCache::GetStats() {
+    return CompressedBlockCacheStats{hit_.load(), miss_.load(), insert_.load(), reject_.load(), cache_.GetUsage()};
+}
+} // namespace rangedb
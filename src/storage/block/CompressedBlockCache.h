@@ -0,0 +1,51 @@
+#pragma once
+#include "storage/block/Block.h"
+#include "storage/block/BlockCacheKey.h"
+#include "utils/ShardedCache.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace rangedb {
+struct CompressedBlockCacheStats {
+    uint64_t hit_;
+    uint64_t miss_;
+    uint64_t insert_;
+    // blocks not worth compressing
+    uint64_t reject_;
+    size_t usage_;
+};
+
+// CompressedBlockCache is the second in-memory tier of the block cache. Sst
+// blocks evicted from the primary cache are compressed with lz4 and kept here
+// under their own byte budget, a primary miss checks this tier before reading
+// the file. A hit is decompressed into a new block and removed from this tier,
+// the caller puts it back to the primary cache.
+class CompressedBlockCache {
+public:
+    CompressedBlockCache(size_t capacity, uint32_t shard_bits);
+
+    // Compress and keep block, returns false if the block is not kept
+    bool Insert(BlockCacheKey key, const storage::BlockPtr &block);
+
+    // Decompressed copy of the block, nullptr on a miss
+    storage::BlockPtr Lookup(BlockCacheKey key);
+
+    void Erase(BlockCacheKey key);
+
+    // Bytes of the compressed blocks kept, capacity bounds them
+    void SetCapacity(size_t capacity);
+
+    size_t GetUsage();
+
+    CompressedBlockCacheStats GetStats();
+
+private:
+    ShardedCache<BlockCacheKey, std::shared_ptr<std::string>, BlockCacheKeyHash> cache_;
+    std::atomic<uint64_t> hit_;
+    std::atomic<uint64_t> miss_;
+    std::atomic<uint64_t> insert_;
+    std::atomic<uint64_t> reject_;
+};
+} // namespace rangedb
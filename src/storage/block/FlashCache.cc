@@ -0,0 +1,277 @@
+#include "storage/block/FlashCache.h"
+#include "storage/sstblock/SstBlock.h"
+#include "utils/CommonUtil.h"
+#include "xxhash.h"
+#include <iostream>
+
+namespace rangedb {
+
+const uint64_t FLASH_CACHE_SLOT_MAGIC = 0x464c415348534c54; // "FLASHSLT"
+const uint64_t FLASH_CACHE_INDEX_MAGIC = 0x464c415348495832; // "FLASHIX2"
+
+FlashCache::FlashCache(const std::string &dir, size_t capacity)
+    : dir_(dir), slot_num_(capacity / FLASH_CACHE_SLOT_SIZE), next_slot_(0), next_seq_(1), insert_since_checkpoint_(0), pending_(0), stop_(true), hit_(0),
+      miss_(0), insert_(0), drop_(0) {}
+
+FlashCache::~FlashCache() { Close(); }
+
+Status FlashCache::Open() {
+    if (slot_num_ == 0) {
+        return Status(DB_ERROR, "flash cache capacity is smaller than one slot");
+    }
+    Status status = CommonUtil::CreateDirectory(dir_);
+    if (!status.ok()) {
+        return status;
+    }
+    file_handle_ = std::make_shared<FileHandle>(dir_ + "/flash_cache.data", true);
+    if (!file_handle_->Open()) {
+        return Status(DB_ERROR, "open flash cache file failed");
+    }
+    slot_keys_.assign(slot_num_, 0);
+    slot_used_.assign(slot_num_, 0);
+    if (!LoadCheckpoint()) {
+        Scan();
+    }
+    stop_ = false;
+    writer_ = std::thread([this]() { Run(); });
+    return Status::OK();
+}
+
+void FlashCache::Close() {
+    if (stop_.exchange(true)) {
+        return;
+    }
+    writer_.join();
+    Checkpoint();
+    file_handle_->Sync();
+    file_handle_->Close();
+}
+
+bool FlashCache::Insert(BlockCacheKey key, const storage::BlockPtr &block) {
+    auto sst_block = std::dynamic_pointer_cast<storage::SstBlock>(block);
+    if (stop_.load(std::memory_order_relaxed) || sst_block == nullptr || !sst_block->IsSealed()) {
+        return false;
+    }
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        if (index_.find(key) != index_.end()) {
+            return true;
+        }
+    }
+    // admission control, never let the flash writer slow down the readers evicting blocks
+    if (pending_.fetch_add(1) >= FLASH_CACHE_QUEUE_SIZE) {
+        pending_.fetch_sub(1);
+        drop_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    queue_.enqueue(std::make_pair(key, block));
+    return true;
+}
+
+storage::BlockPtr FlashCache::Lookup(BlockCacheKey key) {
+    uint32_t slot = 0;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto it = index_.find(key);
+        if (it == index_.end()) {
+            miss_.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        slot = it->second;
+    }
+    int8_t *data = storage::BlockBufferPool()->Allocate();
+    int8_t *header_buffer = AlignedAlloc(FLASH_CACHE_HEADER_SIZE);
+    struct iovec iov[2] = {{data, storage::BLOCK_SIZE}, {header_buffer, FLASH_CACHE_HEADER_SIZE}};
+    bool ok = file_handle_->ReadV(iov, 2, SlotOffset(slot));
+    SlotHeader header;
+    std::memcpy(&header, header_buffer, sizeof(header));
+    AlignedFree(header_buffer);
+    // the slot may have been reused by the writer since the index was read
+    if (!ok || header.magic_ != FLASH_CACHE_SLOT_MAGIC || header.key_high_ != BlockCacheKeyHigh(key) ||
+        header.key_low_ != BlockCacheKeyLow(key) || header.checksum_ != XXH64(data, storage::BLOCK_SIZE, 0)) {
+        storage::BlockBufferPool()->Release(data);
+        miss_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    auto block = std::make_shared<storage::SstBlock>(BlockCacheKeyLow(key));
+    block->InitFromData(data);
+    hit_.fetch_add(1, std::memory_order_relaxed);
+    return block;
+}
+
+void FlashCache::Erase(BlockCacheKey key) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        slot_used_[it->second] = 0;
+        index_.erase(it);
+    }
+}
+
+void FlashCache::WaitForWrites() {
+    while (pending_.load() > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+FlashCacheStats FlashCache::GetStats() { return FlashCacheStats{hit_.load(), miss_.load(), insert_.load(), drop_.load()}; }
+
+void FlashCache::Run() {
+    std::pair<BlockCacheKey, storage::BlockPtr> entry;
+    while (true) {
+        if (!queue_.wait_dequeue_timed(entry, 1000 * 100)) {
+            if (stop_.load()) {
+                break;
+            }
+            continue;
+        }
+        Write(entry.first, entry.second);
+        entry.second = nullptr;
+        pending_.fetch_sub(1);
+    }
+    // blocks still queued are dropped, the cache only holds copies
+    while (queue_.try_dequeue(entry)) {
+        pending_.fetch_sub(1);
+    }
+}
+
+void FlashCache::Write(BlockCacheKey key, const storage::BlockPtr &block) {
+    uint32_t slot = 0;
+    uint64_t seq = 0;
+    {
+        // take the oldest slot out of the index before it is overwritten
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        if (index_.find(key) != index_.end()) {
+            return;
+        }
+        seq = next_seq_++;
+        slot = next_slot_;
+        next_slot_ = (next_slot_ + 1) % slot_num_;
+        if (slot_used_[slot]) {
+            index_.erase(slot_keys_[slot]);
+            slot_used_[slot] = 0;
+        }
+    }
+    int8_t *header_buffer = AlignedAlloc(FLASH_CACHE_HEADER_SIZE);
+    std::memset(header_buffer, 0, FLASH_CACHE_HEADER_SIZE);
+    SlotHeader header{FLASH_CACHE_SLOT_MAGIC, BlockCacheKeyHigh(key), BlockCacheKeyLow(key), XXH64(block->GetData(), storage::BLOCK_SIZE, 0),
+                      seq};
+    std::memcpy(header_buffer, &header, sizeof(header));
+    struct iovec iov[2] = {{const_cast<int8_t *>(block->GetData()), storage::BLOCK_SIZE}, {header_buffer, FLASH_CACHE_HEADER_SIZE}};
+    bool ok = file_handle_->WriteV(iov, 2, SlotOffset(slot));
+    AlignedFree(header_buffer);
+    if (!ok) {
+        std::cout << "flash cache write slot " << slot << " failed" << std::endl;
+        return;
+    }
+    bool checkpoint = false;
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        index_[key] = slot;
+        slot_keys_[slot] = key;
+        slot_used_[slot] = 1;
+        checkpoint = ++insert_since_checkpoint_ >= FLASH_CACHE_CHECKPOINT_INTERVAL;
+    }
+    insert_.fetch_add(1, std::memory_order_relaxed);
+    if (checkpoint) {
+        Checkpoint();
+    }
+}
+
+// index file layout: magic, slot num, next slot, next seq, then used flag and key of every slot
+void FlashCache::Checkpoint() {
+    std::string buffer;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        buffer.reserve(sizeof(uint64_t) * 2 + sizeof(uint32_t) * 2 + slot_num_ * (1 + sizeof(BlockCacheKey)));
+        buffer.append((const char *)&FLASH_CACHE_INDEX_MAGIC, sizeof(FLASH_CACHE_INDEX_MAGIC));
+        buffer.append((const char *)&slot_num_, sizeof(slot_num_));
+        buffer.append((const char *)&next_slot_, sizeof(next_slot_));
+        buffer.append((const char *)&next_seq_, sizeof(next_seq_));
+        for (uint32_t i = 0; i < slot_num_; i++) {
+            buffer.append((const char *)&slot_used_[i], 1);
+            buffer.append((const char *)&slot_keys_[i], sizeof(BlockCacheKey));
+        }
+        insert_since_checkpoint_ = 0;
+    }
+    // write a new file and rename it over the old one, a crash keeps one of them complete
+    std::string tmp_name = dir_ + "/flash_cache.index.tmp";
+    unlink(tmp_name.c_str());
+    FileHandle index_file(tmp_name);
+    if (!index_file.Open() || !index_file.WriteAt(buffer.data(), buffer.size(), 0)) {
+        std::cout << "flash cache checkpoint failed" << std::endl;
+        return;
+    }
+    index_file.Sync();
+    index_file.Close();
+    rename(tmp_name.c_str(), (dir_ + "/flash_cache.index").c_str());
+}
+
+bool FlashCache::LoadCheckpoint() {
+    std::string index_name = dir_ + "/flash_cache.index";
+    if (access(index_name.c_str(), F_OK) != 0) {
+        return false;
+    }
+    FileHandle index_file(index_name);
+    if (!index_file.Open()) {
+        return false;
+    }
+    size_t size = sizeof(uint64_t) * 2 + sizeof(uint32_t) * 2 + slot_num_ * (1 + sizeof(BlockCacheKey));
+    std::string buffer(size, '\0');
+    bool ok = index_file.Read(buffer.data(), size, 0);
+    index_file.Close();
+    uint64_t magic = 0;
+    uint32_t slot_num = 0;
+    std::memcpy(&magic, buffer.data(), sizeof(magic));
+    std::memcpy(&slot_num, buffer.data() + sizeof(magic), sizeof(slot_num));
+    // a capacity change invalidates the index, the slots are rescanned
+    if (!ok || magic != FLASH_CACHE_INDEX_MAGIC || slot_num != slot_num_) {
+        return false;
+    }
+    size_t offset = sizeof(magic) + sizeof(slot_num);
+    std::memcpy(&next_slot_, buffer.data() + offset, sizeof(next_slot_));
+    offset += sizeof(next_slot_);
+    std::memcpy(&next_seq_, buffer.data() + offset, sizeof(next_seq_));
+    offset += sizeof(next_seq_);
+    for (uint32_t i = 0; i < slot_num_; i++) {
+        slot_used_[i] = buffer[offset];
+        std::memcpy(&slot_keys_[i], buffer.data() + offset + 1, sizeof(BlockCacheKey));
+        offset += 1 + sizeof(BlockCacheKey);
+        if (slot_used_[i]) {
+            index_[slot_keys_[i]] = i;
+        }
+    }
+    next_slot_ %= slot_num_;
+    return true;
+}
+
+void FlashCache::Scan() {
+    int8_t *header_buffer = AlignedAlloc(FLASH_CACHE_HEADER_SIZE);
+    uint64_t max_seq = 0;
+    uint32_t max_seq_slot = 0;
+    for (uint32_t i = 0; i < slot_num_; i++) {
+        if (!file_handle_->Read(header_buffer, FLASH_CACHE_HEADER_SIZE, SlotOffset(i) + storage::BLOCK_SIZE)) {
+            // end of the cache file, the ring has not wrapped yet
+            break;
+        }
+        SlotHeader header;
+        std::memcpy(&header, header_buffer, sizeof(header));
+        if (header.magic_ != FLASH_CACHE_SLOT_MAGIC) {
+            continue;
+        }
+        BlockCacheKey key = MakeBlockCacheKey(header.key_high_, header.key_low_);
+        slot_keys_[i] = key;
+        slot_used_[i] = 1;
+        index_[key] = i;
+        if (header.seq_ > max_seq) {
+            max_seq = header.seq_;
+            max_seq_slot = i;
+        }
+    }
+    AlignedFree(header_buffer);
+    // the slot after the newest one is the oldest once the ring has wrapped, the first
+    // unwritten one before
+    next_slot_ = max_seq == 0 ? 0 : (max_seq_slot + 1) % slot_num_;
+    next_seq_ = max_seq + 1;
+}
+} // namespace rangedb
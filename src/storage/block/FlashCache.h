@@ -0,0 +1,102 @@
+#pragma once
+#include "concurrentqueue/blockingconcurrentqueue.h"
+#include "storage/block/Block.h"
+#include "storage/block/BlockCacheKey.h"
+#include "utils/FileHandle.h"
+#include "utils/Status.h"
+#include <atomic>
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace rangedb {
+// every slot holds the block data followed by a 4KB header, both aligned for O_DIRECT
+const size_t FLASH_CACHE_HEADER_SIZE = DIRECT_IO_ALIGNMENT;
+const size_t FLASH_CACHE_SLOT_SIZE = storage::BLOCK_SIZE + FLASH_CACHE_HEADER_SIZE;
+// blocks waiting to be written, evicted blocks are dropped while the queue is full
+const size_t FLASH_CACHE_QUEUE_SIZE = 256;
+// the index is checkpointed after this many inserts and on Close
+const size_t FLASH_CACHE_CHECKPOINT_INTERVAL = 4096;
+
+struct FlashCacheStats {
+    uint64_t hit_;
+    uint64_t miss_;
+    uint64_t insert_;
+    // blocks not admitted because the writer was behind
+    uint64_t drop_;
+};
+
+// FlashCache is a persistent block cache on a fast local device (e.g. NVMe)
+// for sst files living on a slower volume. The cache file is a ring of fixed
+// size slots written in log order, the oldest slot is overwritten first.
+// Blocks evicted from memory are queued by Insert and written by a background
+// thread, the in-memory index maps a block to its slot and is checkpointed to
+// an index file so the cache survives restarts. Every slot header carries the
+// block key and a checksum of the data, a read that does not match is a miss.
+class FlashCache {
+public:
+    FlashCache(const std::string &dir, size_t capacity);
+    ~FlashCache();
+
+    // Open or create the cache file and load the index
+    Status Open();
+
+    // Stop the writer, checkpoint the index and close the cache file
+    void Close();
+
+    // Queue a block to be written, returns false if it is not admitted
+    bool Insert(BlockCacheKey key, const storage::BlockPtr &block);
+
+    // Read the block from the cache file, nullptr on a miss
+    storage::BlockPtr Lookup(BlockCacheKey key);
+
+    void Erase(BlockCacheKey key);
+
+    // Wait until all queued blocks are written
+    void WaitForWrites();
+
+    FlashCacheStats GetStats();
+
+private:
+    struct SlotHeader {
+        uint64_t magic_;
+        uint64_t key_high_;
+        uint64_t key_low_;
+        uint64_t checksum_;
+        // write order of the slot, a scan resumes after the newest slot
+        uint64_t seq_;
+    };
+
+    void Run();
+    void Write(BlockCacheKey key, const storage::BlockPtr &block);
+    bool LoadCheckpoint();
+    void Scan();
+    void Checkpoint();
+    inline off64_t SlotOffset(uint32_t slot) const { return (off64_t)slot * FLASH_CACHE_SLOT_SIZE; }
+
+    std::string dir_;
+    uint32_t slot_num_;
+    FileHandlePtr file_handle_;
+    std::shared_mutex mutex_;
+    std::unordered_map<BlockCacheKey, uint32_t, BlockCacheKeyHash> index_;
+    std::vector<BlockCacheKey> slot_keys_;
+    std::vector<uint8_t> slot_used_;
+    uint32_t next_slot_;
+    uint64_t next_seq_;
+    uint64_t insert_since_checkpoint_;
+
+    moodycamel::BlockingConcurrentQueue<std::pair<BlockCacheKey, storage::BlockPtr>> queue_;
+    std::atomic<size_t> pending_;
+    std::atomic<bool> stop_;
+    std::thread writer_;
+
+    std::atomic<uint64_t> hit_;
+    std::atomic<uint64_t> miss_;
+    std::atomic<uint64_t> insert_;
+    std::atomic<uint64_t> drop_;
+};
+} // namespace rangedb
@@ -9,6 +9,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <list>
+#include <memory>
 namespace rangedb {
 void CompactionTask::Compact() {
     if (wal_compact_flag_) {
@@ -35,13 +36,14 @@ void CompactionTask::WalBlockToCompaction() {
     }
     for (auto &file : high_level_file_) {
         auto block_file = std::dynamic_pointer_cast<storage::SstBlockFile>(file);
-        Iterator *iter = file->NewIterator(comparator);
+        // compaction inputs are read once, keep them out of the block cache
+        Iterator *iter = block_file->NewIterator(comparator, CacheHint::NO_FILL);
         file_lst.push_back(iter);
     }
     Iterator *iter = storage::NewMergingIterator(cmp_, file_lst);
     iter->SeekToFirst();
     uint64_t file_id = storage::BlockFile::gloabal_block_id_.fetch_add(1);
-    storage::SstBlockFile sst_file(file_id);
+    auto sst_file = std::make_shared<storage::SstBlockFile>(file_id);
     bool flag = false;
     while (!iter->End()) {
         // construct two sst file
@@ -49,18 +51,18 @@ void CompactionTask::WalBlockToCompaction() {
         if (flag) {
             std::cout << "item: " << item.key_.ToString() << std::endl;
         }
-        auto status = sst_file.Append(&item);
+        auto status = sst_file->Append(&item);
         iter->Next();
         if (status == SST_BLOCK_FULL_ERROR) {
             // log error
-            sst_file.Flush();
+            sst_file->Flush();
             file_id = storage::BlockFile::gloabal_block_id_.fetch_add(1);
-            sst_file = storage::SstBlockFile(file_id);
+            sst_file = std::make_shared<storage::SstBlockFile>(file_id);
             flag = true;
-            sst_file.Append(&item);
+            sst_file->Append(&item);
         }
     }
-    sst_file.Flush();
+    sst_file->Flush();
 }
 
 void CompactionTask::SstBlockToCompaction() {
@@ -71,11 +73,11 @@ void CompactionTask::SstBlockToCompaction() {
         storage::BlockFilePtr h_file = high_level_file_.front();
         high_level_file_.pop_front();
         auto h_block_file = std::dynamic_pointer_cast<storage::SstBlockFile>(h_file);
-        Iterator *h_iter = h_block_file->NewIterator(cmp_);
+        Iterator *h_iter = h_block_file->NewIterator(cmp_, CacheHint::NO_FILL);
         storage::BlockFilePtr l_file = low_level_file_.front();
         auto l_block_file = std::dynamic_pointer_cast<storage::SstBlockFile>(l_file);
         low_level_file_.pop_front();
-        Iterator *l_iter = l_block_file->NewIterator(cmp_);
+        Iterator *l_iter = l_block_file->NewIterator(cmp_, CacheHint::NO_FILL);
         std::list<Iterator *> file_lst;
         file_lst.emplace_back(h_iter);
         file_lst.emplace_back(l_iter);
@@ -90,14 +92,14 @@ void CompactionTask::SstBlockToCompaction() {
         if (data_size > 512 * 1024 * 1024) {
             // construct two sst file
             uint64_t file_id = storage::BlockFile::gloabal_block_id_.fetch_add(1);
-            storage::SstBlockFile sst_file(file_id);
+            auto sst_file = std::make_shared<storage::SstBlockFile>(file_id);
             for (auto &item : item_lst) {
-                sst_file.Append(&item);
+                sst_file->Append(&item);
             }
-            int block_num = sst_file.GetBlockNum();
+            int block_num = sst_file->GetBlockNum();
             if (block_num > 256 * 16) {
-                sst_file.Flush();
-                sst_file = storage::SstBlockFile(file_id);
+                sst_file->Flush();
+                sst_file = std::make_shared<storage::SstBlockFile>(file_id);
             }
         }
         // read sst block
@@ -160,6 +160,101 @@ private:
     }
 };
 
+// Key of the record at offset, decoded without touching the value
+static inline ByteKey DecodeKey(const int8_t *record) {
+    ByteKey key;
+    record += SLICE_HEADER_SIZE;
+    std::memcpy(&key.length_, record, sizeof(key.length_));
+    std::memcpy(&key.hash_0_, record + sizeof(key.length_), sizeof(key.hash_0_));
+    std::memcpy(key.data_, record + sizeof(key.length_) + sizeof(key.hash_0_), key.length_);
+    return key;
+}
+
+static inline uint32_t RecordSize(const int8_t *record) {
+    uint32_t size = 0;
+    std::memcpy(&size, record, sizeof(size));
+    return size;
+}
+
+void SstBlock::BuildHashIndex() {
+    uint32_t interval_num = interval_offset_.size();
+    if (!SST_BLOCK_HASH_INDEX || counter_ == 0 || interval_num > HASH_INDEX_MAX_INTERVAL ||
+        write_offset_ + HashIndexSize(counter_) > BLOCK_SIZE) {
+        hash_index_offset_ = 0;
+        return;
+    }
+    uint16_t bucket_num = HashIndexBucketNum(counter_);
+    int8_t *index = data_ + write_offset_;
+    std::memcpy(index, &interval_num, sizeof(uint16_t));
+    std::memcpy(index + sizeof(uint16_t), &bucket_num, sizeof(uint16_t));
+    std::memcpy(index + sizeof(uint16_t) * 2, interval_offset_.data(), interval_num * sizeof(uint16_t));
+    uint8_t *buckets = (uint8_t *)index + sizeof(uint16_t) * 2 + interval_num * sizeof(uint16_t);
+    std::memset(buckets, HASH_INDEX_EMPTY, bucket_num);
+    for (uint32_t i = 0; i < counter_; i++) {
+        uint8_t &bucket = buckets[(uint64_t)key_hashes_[i] % bucket_num];
+        uint8_t interval = i / HASH_INDEX_INTERVAL;
+        if (bucket == HASH_INDEX_EMPTY) {
+            bucket = interval;
+        } else if (bucket != interval) {
+            bucket = HASH_INDEX_COLLISION;
+        }
+    }
+    hash_index_offset_ = write_offset_;
+}
+
+bool SstBlock::SeekInInterval(const ByteKey &key, uint32_t start, uint32_t end, Slice *slice) const {
+    uint32_t offset = start;
+    while (offset < end) {
+        const int8_t *record = data_ + offset;
+        ByteKey record_key = DecodeKey(record);
+        int compare = record_key.Compare(key);
+        if (compare == 0) {
+            slice->Deserialize((int8_t *)record);
+            return true;
+        }
+        if (compare > 0) {
+            return false;
+        }
+        offset += RecordSize(record);
+    }
+    return false;
+}
+
+bool SstBlock::Get(Slice *slice) const {
+    const ByteKey &key = slice->key_;
+    if (hash_index_offset_ != 0) {
+        const int8_t *index = data_ + hash_index_offset_;
+        uint16_t interval_num = *(uint16_t *)index;
+        uint16_t bucket_num = *(uint16_t *)(index + sizeof(uint16_t));
+        const uint16_t *interval_offset = (const uint16_t *)(index + sizeof(uint16_t) * 2);
+        const uint8_t *buckets = (const uint8_t *)(interval_offset + interval_num);
+        uint8_t interval = buckets[(uint64_t)key.hash_0_ % bucket_num];
+        if (interval == HASH_INDEX_EMPTY) {
+            return false;
+        }
+        if (interval != HASH_INDEX_COLLISION) {
+            uint32_t end = interval + 1 < interval_num ? interval_offset[interval + 1] : write_offset_;
+            return SeekInInterval(key, interval_offset[interval], end, slice);
+        }
+    }
+    if (num_restarts_ == 0) {
+        return false;
+    }
+    // binary search for the last restart point with a key <= target
+    uint32_t left = 0;
+    uint32_t right = num_restarts_ - 1;
+    while (left < right) {
+        uint32_t mid = (left + right + 1) / 2;
+        if (DecodeKey(data_ + restart_offset_[mid]).Compare(key) <= 0) {
+            left = mid;
+        } else {
+            right = mid - 1;
+        }
+    }
+    uint32_t end = left + 1 < num_restarts_ ? restart_offset_[left + 1] : write_offset_;
+    return SeekInInterval(key, restart_offset_[left], end, slice);
+}
+
 Iterator *SstBlock::NewIterator(const Comparator *comparator) {
     return new Iter(comparator, (int8_t *)data_, restart_offset_, num_restarts_, write_offset_);
 }
@@ -9,21 +9,37 @@
 #include <memory>
 #include <unistd.h>
 #include <utility>
+#include <vector>
 
 namespace rangedb {
 namespace storage {
 const size_t SSTBLOCK_HEAD_SIZE = 256;
+// build a hash index at the end of every sst block for point lookups
+const bool SST_BLOCK_HASH_INDEX = true;
+// records per hash index interval, a lookup decodes at most one interval
+const uint32_t HASH_INDEX_INTERVAL = 16;
+// buckets per record is 1 / HASH_INDEX_UTIL_RATIO
+const double HASH_INDEX_UTIL_RATIO = 0.75;
+const uint8_t HASH_INDEX_EMPTY = 255;
+const uint8_t HASH_INDEX_COLLISION = 254;
+const uint32_t HASH_INDEX_MAX_INTERVAL = 254;
+// the hash index offset is stored in the block header right after the restart array
+const size_t HASH_INDEX_OFFSET_POS = sizeof(size_t) + sizeof(uint32_t) + 32 * sizeof(uint32_t);
+
 class SstBlock : virtual public Block {
 public:
     SstBlock(uint64_t block_id) : block_id_(block_id) {
         block_id_ = block_id;
-        data_ = new int8_t[BLOCK_SIZE]{0};
+        data_ = BlockBufferPool()->Allocate();
+        std::memset(data_, 0, BLOCK_SIZE);
         write_offset_ = SSTBLOCK_HEAD_SIZE;
         num_restarts_ = 0;
         counter_ = 0;
+        hash_index_offset_ = 0;
+        sealed_ = false;
     }
 
-    ~SstBlock() { delete data_; }
+    ~SstBlock() { BlockBufferPool()->Release(data_); }
 
     void Append(Slice *slice) {
         slice->offset_ = write_offset_;
@@ -33,6 +49,14 @@ public:
             restart_offset_[num_restarts_] = write_offset_;
             num_restarts_++;
         }
+        // the index is rebuilt by the next Finshed, records overwrite the old one
+        hash_index_offset_ = 0;
+        if (SST_BLOCK_HASH_INDEX) {
+            if (counter_ % HASH_INDEX_INTERVAL == 0) {
+                interval_offset_.emplace_back(write_offset_);
+            }
+            key_hashes_.emplace_back(slice->key_.hash_0_);
+        }
         slice->Serialize(data_ + write_offset_);
         write_offset_ += slice->Size();
         counter_++;
@@ -46,21 +70,43 @@ public:
     bool IsFull() const { return write_offset_ + 128 >= BLOCK_SIZE; }
 
     void Finshed() {
+        BuildHashIndex();
         std::memcpy(data_, &write_offset_, sizeof(write_offset_));
         std::memcpy(data_ + sizeof(write_offset_), &num_restarts_, sizeof(num_restarts_));
         std::memcpy(data_ + sizeof(write_offset_) + sizeof(num_restarts_), restart_offset_.data(), num_restarts_ * sizeof(uint32_t));
+        std::memcpy(data_ + HASH_INDEX_OFFSET_POS, &hash_index_offset_, sizeof(hash_index_offset_));
     }
 
     const int8_t *GetData() const { return data_; }
 
+    // True once the block holds data read back from a file and will not change any more
+    bool IsSealed() const { return sealed_; }
+
+    size_t GetCharge() const {
+        return BLOCK_SIZE + sizeof(SstBlock) + interval_offset_.capacity() * sizeof(uint16_t) + key_hashes_.capacity() * sizeof(int64_t);
+    }
+
+    // Take over data, it must come from BlockBufferPool()
     void InitFromData(int8_t *data) {
         std::memcpy(&write_offset_, data, sizeof(write_offset_));
         num_restarts_ = *(uint32_t *)(data + sizeof(write_offset_));
         std::memcpy(restart_offset_.data(), data + sizeof(write_offset_) + sizeof(num_restarts_), num_restarts_ * sizeof(uint32_t));
-        data_ = std::move(data);
+        // blocks written before the hash index have zeros here
+        std::memcpy(&hash_index_offset_, data + HASH_INDEX_OFFSET_POS, sizeof(hash_index_offset_));
+        if (data_ != data) {
+            BlockBufferPool()->Release(data_);
+        }
+        data_ = data;
+        sealed_ = true;
     }
 
-    size_t GetSize() const { return write_offset_ - sizeof(size_t); }
+    // Bytes used once one more record is appended, including the hash index built by Finshed
+    size_t GetSize() const { return write_offset_ + (SST_BLOCK_HASH_INDEX ? HashIndexSize(counter_ + 1) : 0); }
+
+    // Point lookup of slice->key_, fills slice and returns true if the key is in the block.
+    // Uses the hash index to pick the interval to decode, falls back to a binary search
+    // over the restart points when the block has no index or the bucket collided.
+    bool Get(Slice *slice) const;
 
     inline void Serialize(int8_t *buffer) const { std::memcpy(data_, &write_offset_, sizeof(write_offset_)); }
 
@@ -69,6 +115,19 @@ public:
 private:
     class Iter;
 
+    static inline uint32_t HashIndexBucketNum(uint32_t record_num) { return record_num / HASH_INDEX_UTIL_RATIO + 1; }
+
+    // layout: uint16 interval num, uint16 bucket num, uint16 interval offsets, uint8 buckets
+    static inline size_t HashIndexSize(uint32_t record_num) {
+        uint32_t interval_num = (record_num + HASH_INDEX_INTERVAL - 1) / HASH_INDEX_INTERVAL;
+        return sizeof(uint16_t) * 2 + interval_num * sizeof(uint16_t) + HashIndexBucketNum(record_num);
+    }
+
+    void BuildHashIndex();
+
+    // Scan the records in [start, end) for key, stops at the first larger key
+    bool SeekInInterval(const ByteKey &key, uint32_t start, uint32_t end, Slice *slice) const;
+
 private:
     std::array<uint32_t, 32> restart_offset_;
     size_t write_offset_;
@@ -76,6 +135,11 @@ private:
     uint64_t block_id_;
     uint32_t num_restarts_;
     uint32_t counter_;
+    uint32_t hash_index_offset_;
+    bool sealed_;
+    // hash index build state, only kept by blocks being written
+    std::vector<uint16_t> interval_offset_;
+    std::vector<int64_t> key_hashes_;
 };
 
 using SstBlockPtr = std::shared_ptr<SstBlock>;
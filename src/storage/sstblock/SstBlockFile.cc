@@ -5,6 +5,7 @@
 #include "utils/Iterator.h"
 #include "utils/Slice.h"
 #include "utils/Status.h"
+#include <algorithm>
 #include <atomic>
 #include <cstdint>
 #include <vector>
@@ -25,12 +26,51 @@ storage::BlockPtr SstBlockFile::AddBlock() {
 
 BlockPtr SstBlockFile::ReadBlock(size_t inner_block_id) {
     BlockPtr block = std::make_shared<storage::SstBlock>(inner_block_id);
-    int8_t *data = new int8_t[BLOCK_SIZE];
+    int8_t *data = BlockBufferPool()->Allocate();
+    if (!file_handle_->Read(data, BLOCK_SIZE, GetBlockOffset(inner_block_id))) {
+        BlockBufferPool()->Release(data);
+        return nullptr;
+    }
     block->InitFromData(data);
-    file_handle_->Read(data, BLOCK_SIZE, inner_block_id * BLOCK_SIZE + SST_BLOCKFILE_HEADER_SIZE);
     return block;
 }
 
+RecordPtr SstBlockFile::ReadRecord(size_t inner_block_id, uint64_t offset, uint32_t length) {
+    if (length == 0 || offset + length > BLOCK_SIZE) {
+        return nullptr;
+    }
+    off64_t record_start = GetBlockOffset(inner_block_id) + offset;
+    off64_t page_start = AlignDown(record_start);
+    size_t read_size = AlignUp(record_start + length) - page_start;
+    int8_t *pages = AlignedAlloc(read_size);
+    if (!file_handle_->Read(pages, read_size, page_start)) {
+        AlignedFree(pages);
+        return nullptr;
+    }
+    RecordPtr record = std::make_shared<std::string>((char *)pages + (record_start - page_start), length);
+    AlignedFree(pages);
+    return record;
+}
+
+size_t SstBlockFile::ReadBlocks(size_t start_block_id, size_t count, std::vector<BlockPtr> *blocks) {
+    std::vector<struct iovec> iov(count);
+    for (size_t i = 0; i < count; i++) {
+        iov[i] = {BlockBufferPool()->Allocate(), BLOCK_SIZE};
+    }
+    if (!file_handle_->ReadV(iov.data(), count, GetBlockOffset(start_block_id))) {
+        for (auto &vec : iov) {
+            BlockBufferPool()->Release(static_cast<int8_t *>(vec.iov_base));
+        }
+        return 0;
+    }
+    for (size_t i = 0; i < count; i++) {
+        BlockPtr block = std::make_shared<storage::SstBlock>(start_block_id + i);
+        block->InitFromData(static_cast<int8_t *>(iov[i].iov_base));
+        blocks->emplace_back(block);
+    }
+    return count;
+}
+
 StatusCode SstBlockFile::Append(Slice *source) {
     if (block_list_.empty()) {
         AddBlock();
@@ -41,7 +81,7 @@ StatusCode SstBlockFile::Append(Slice *source) {
     //    return SST_BLOCK_FULL_ERROR;
     //}
 
-    if (storage::BLOCK_SIZE - block->GetSize() < source->Size()) {
+    if (block->GetSize() + source->Size() > storage::BLOCK_SIZE) {
         block_min_key_vec_.emplace_back(source->key_);
         block = AddBlock();
     }
@@ -51,9 +91,11 @@ StatusCode SstBlockFile::Append(Slice *source) {
 
 Status SstBlockFile::Flush() {
     // build blockfile header
-    int8_t *header = new int8_t[storage::SST_BLOCKFILE_HEADER_SIZE];
+    int8_t *header = AlignedAlloc(storage::SST_BLOCKFILE_HEADER_SIZE);
+    std::memset(header, 0, storage::SST_BLOCKFILE_HEADER_SIZE);
     uint32_t offset = 0;
-    std::memcpy(header + offset, &block_num_, sizeof(uint32_t));
+    uint32_t block_num = block_num_;
+    std::memcpy(header + offset, &block_num, sizeof(uint32_t));
     offset += sizeof(uint32_t);
     for (int i = 0; i < block_min_key_vec_.size(); i++) {
         std::memcpy(header + offset, &block_min_key_vec_[i].length_, sizeof(uint32_t));
@@ -61,39 +103,161 @@ Status SstBlockFile::Flush() {
         std::memcpy(header + offset, block_min_key_vec_[i].data_, block_min_key_vec_[i].length_);
         offset += block_min_key_vec_[i].length_;
     }
-    // Flush header to file
-    file_handle_->Write(header, storage::SST_BLOCKFILE_HEADER_SIZE);
-    // Flush data to file
+    // Flush header and blocks to file in one pwritev, block_list_ holds the blocks
+    // not flushed yet plus the last flushed one, they are contiguous on disk
+    size_t first_block_id = block_num_ - block_list_.size();
+    std::vector<struct iovec> iov;
+    iov.reserve(block_list_.size() + 1);
+    if (first_block_id == 0) {
+        iov.push_back({header, storage::SST_BLOCKFILE_HEADER_SIZE});
+    } else if (!file_handle_->WriteAt(header, storage::SST_BLOCKFILE_HEADER_SIZE, 0)) {
+        AlignedFree(header);
+        return Status(DB_WRITE_BLOCK_ERROR, "write sst file header failed");
+    }
     for (auto &&iter = block_list_.begin(); iter != block_list_.end(); iter++) {
         auto block = *iter;
         block->Finshed();
-        file_handle_->Write(block->GetData(), storage::BLOCK_SIZE);
+        iov.push_back({const_cast<int8_t *>(block->GetData()), storage::BLOCK_SIZE});
+    }
+    off64_t block_offset = first_block_id == 0 ? 0 : GetBlockOffset(first_block_id);
+    bool ok = file_handle_->WriteV(iov.data(), iov.size(), block_offset);
+    AlignedFree(header);
+    if (!ok) {
+        return Status(DB_WRITE_BLOCK_ERROR, "write sst file blocks failed");
     }
     file_handle_->Sync();
+    if (block_list_.empty()) {
+        // a file without records, only the header was written
+        return Status::OK();
+    }
     auto last_block = block_list_.back();
     block_list_.clear();
     block_list_.emplace_back(last_block);
     return Status::OK();
 }
 
-Status SstBlockFile::InitFromData(int8_t *data) {
+std::vector<BlockPtr> SstBlockFile::TakeFullBlocks() {
+    std::vector<BlockPtr> blocks;
+    while (block_list_.size() > 1) {
+        blocks.emplace_back(block_list_.front());
+        block_list_.pop_front();
+    }
+    return blocks;
+}
+
+Status SstBlockFile::WriteBlocks(size_t first_block_id, const std::vector<BlockPtr> &blocks) {
+    std::vector<struct iovec> iov;
+    iov.reserve(blocks.size());
+    for (auto &block : blocks) {
+        block->Finshed();
+        iov.push_back({const_cast<int8_t *>(block->GetData()), storage::BLOCK_SIZE});
+    }
+    if (!iov.empty() && !file_handle_->WriteV(iov.data(), iov.size(), GetBlockOffset(first_block_id))) {
+        return Status(DB_WRITE_BLOCK_ERROR, "write sst file blocks failed");
+    }
+    return Status::OK();
+}
+
+void SstBlockFile::ParseHeader(const int8_t *data) {
     uint32_t offset = 0;
-    std::memcpy(&block_num_, data + offset, sizeof(uint32_t));
+    uint32_t block_num = 0;
+    std::memcpy(&block_num, data + offset, sizeof(uint32_t));
     offset += sizeof(uint32_t);
-    for (int i = 0; i < block_num_ - 1; i++) {
+    std::vector<ByteKey> block_min_key_vec;
+    for (int i = 0; i < (int)block_num - 1; i++) {
         uint32_t length_ = 0;
         std::memcpy(&length_, data + offset, sizeof(uint32_t));
         offset += sizeof(uint32_t);
         ByteKey key((int8_t *)data + offset, length_);
-        block_min_key_vec_.emplace_back(key);
+        block_min_key_vec.emplace_back(key);
         offset += length_;
     }
-    offset = storage::SST_BLOCKFILE_HEADER_SIZE;
+    block_min_key_vec_.swap(block_min_key_vec);
+    // a Get that sees the block number finds the min keys filled
+    block_num_.store(block_num, std::memory_order_release);
+}
+
+Status SstBlockFile::ReadHeader() {
+    int8_t *header = AlignedAlloc(storage::SST_BLOCKFILE_HEADER_SIZE);
+    if (!file_handle_->Read(header, storage::SST_BLOCKFILE_HEADER_SIZE, 0)) {
+        AlignedFree(header);
+        return Status(DB_READ_BLOCK_ERROR, "read sst file header failed");
+    }
+    ParseHeader(header);
+    AlignedFree(header);
+    return Status::OK();
+}
+
+Status SstBlockFile::LoadHeader() {
+    std::lock_guard<std::mutex> lock(header_mutex_);
+    if (block_num_.load(std::memory_order_acquire) != 0) {
+        return Status::OK();
+    }
+    return ReadHeader();
+}
+
+BlockPtr SstBlockFile::LoadBlock(size_t inner_block_id, CacheHint hint) {
+    return inflight_reads_.Do(inner_block_id, [this, inner_block_id, hint]() {
+        // the read that just finished may have filled the cache after our miss
+        BlockPtr block = block_manager_->GetBlock(file_id_, inner_block_id);
+        if (block != nullptr) {
+            return block;
+        }
+        block = ReadBlock(inner_block_id);
+        if (block != nullptr) {
+            block_manager_->AddBlockCache(file_id_, inner_block_id, block, hint);
+        }
+        return block;
+    });
+}
+
+BlockPtr SstBlockFile::GetBlock(size_t inner_block_id, CacheHint hint) {
+    BlockPtr block = block_manager_->GetBlock(file_id_, inner_block_id);
+    if (block == nullptr) {
+        block = LoadBlock(inner_block_id, hint);
+    }
+    return block;
+}
+
+BlockHandle SstBlockFile::PinBlock(size_t inner_block_id, CacheHint hint) {
+    BlockHandle handle = block_manager_->PinBlock(file_id_, inner_block_id);
+    if (handle == nullptr) {
+        handle = BlockHandle(LoadBlock(inner_block_id, hint));
+    }
+    return handle;
+}
+
+Status SstBlockFile::Get(Slice *source) {
+    if (block_num_.load(std::memory_order_acquire) == 0) {
+        Status status = LoadHeader();
+        if (!status.ok()) {
+            return status;
+        }
+    }
+    // block_min_key_vec_[i] is the first key of block i + 1
+    size_t block_id = std::upper_bound(block_min_key_vec_.begin(), block_min_key_vec_.end(), source->key_) - block_min_key_vec_.begin();
+    BlockHandle block = PinBlock(block_id, CacheHint::NORMAL);
+    if (block == nullptr) {
+        return Status(DB_READ_BLOCK_ERROR, "read block failed");
+    }
+    auto sst_block = dynamic_cast<SstBlock *>(block.Get());
+    if (sst_block == nullptr || !sst_block->Get(source)) {
+        return Status(DB_NOT_FOUND, "key not found");
+    }
+    block.HoldValue(source);
+    return Status::OK();
+}
+
+Status SstBlockFile::InitFromData(int8_t *data) {
+    ParseHeader(data);
+    uint32_t offset = storage::SST_BLOCKFILE_HEADER_SIZE;
     for (int i = 0; i < block_num_; i++) {
         auto block = std::make_shared<storage::SstBlock>(i);
-        block->InitFromData(data + offset);
+        int8_t *block_data = BlockBufferPool()->Allocate();
+        std::memcpy(block_data, data + offset, storage::BLOCK_SIZE);
+        block->InitFromData(block_data);
         block_list_.emplace_back(block);
-        block_manager_->AddBlockCache(file_id_, i, block);
+        block_manager_->AddBlockCache(file_id_, i, block, CacheHint::LOW_PRIORITY);
         offset += storage::BLOCK_SIZE;
     }
     return Status::OK();
@@ -102,13 +266,13 @@ Status SstBlockFile::InitFromData(int8_t *data) {
 class SstBlockFile::Iter : public Iterator {
 private:
     const Comparator *const comparator_;
-    uint64_t file_id_;
+    SstBlockFile *file_;
+    CacheHint hint_;
     uint64_t start_block_id_;
     uint64_t current_block_id_;
     BlockPtr block_;
     Iterator *iter_;
     uint32_t num_restarts_;
-    BlockManagerPtr block_manager_;
     const std::vector<ByteKey> *restart_offset_;
     Status status_;
     inline int Compare(const ByteKey &a, const ByteKey &b) const { return comparator_->Compare(a, b); }
@@ -121,18 +285,17 @@ private:
     }
 
     void SeekToRestartPoint(uint32_t index) {
-        block_ = block_manager_->GetBlock(file_id_, index);
+        block_ = file_->GetBlock(index, hint_);
         iter_ = block_->NewIterator(comparator_);
         // ParseNextKey() starts at the end of value_, so set value_ accordingly
         // uint32_t offset = GetRestartPoint(index);
     }
 
 public:
-    Iter(const Comparator *comparator, std::vector<ByteKey> *restart_offset, uint64_t file_id)
+    Iter(const Comparator *comparator, std::vector<ByteKey> *restart_offset, SstBlockFile *file, CacheHint hint)
         : comparator_(comparator), restart_offset_(restart_offset), start_block_id_(0), current_block_id_(start_block_id_),
-          num_restarts_(restart_offset->size()), file_id_(file_id) {
+          num_restarts_(restart_offset->size()), file_(file), hint_(hint) {
         assert(num_restarts_ >= 0);
-        block_manager_ = BlockManager::GetInstance();
     }
 
     bool Valid() const override { return true; }
@@ -144,7 +307,7 @@ public:
         std::cout << "block_id: " << current_block_id_ << std::endl;
         if (iter_->End() && current_block_id_ < num_restarts_) {
             current_block_id_++;
-            block_ = block_manager_->GetBlock(file_id_, current_block_id_);
+            block_ = file_->GetBlock(current_block_id_, hint_);
             iter_ = block_->NewIterator(comparator_);
             iter_->SeekToFirst();
         }
@@ -168,7 +331,7 @@ public:
     void Prev() override {
         assert(Valid());
         if (iter_->End()) {
-            block_ = block_manager_->GetBlock(file_id_, current_block_id_ - 1);
+            block_ = file_->GetBlock(current_block_id_ - 1, hint_);
         } else {
             iter_->Prev();
         }
@@ -221,7 +384,7 @@ public:
         // We might be able to use our current position within the restart block.
         // This is true if we determined the key we desire is in the current block
         // and is after than the current key.
-        block_ = block_manager_->GetBlock(file_id_, current_block_id_ - 1);
+        block_ = file_->GetBlock(current_block_id_ - 1, hint_);
         iter_ = block_->NewIterator(comparator_);
         iter_->Seek(target);
     }
@@ -243,7 +406,11 @@ private:
     }
 };
 
-Iterator *SstBlockFile::NewIterator(const Comparator *comparator) { return new Iter(comparator, &block_min_key_vec_, file_id_); }
+Iterator *SstBlockFile::NewIterator(const Comparator *comparator) { return NewIterator(comparator, CacheHint::LOW_PRIORITY); }
+
+Iterator *SstBlockFile::NewIterator(const Comparator *comparator, CacheHint hint) {
+    return new Iter(comparator, &block_min_key_vec_, this, hint);
+}
 
 } // namespace storage
 } // namespace rangedb
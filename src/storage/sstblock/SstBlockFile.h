@@ -5,12 +5,16 @@
 #include "storage/block/Block.h"
 #include "storage/block/BlockManager.h"
 #include "utils/FileHandle.h"
+#include "utils/SingleFlight.h"
 #include "utils/Slice.h"
 #include "utils/Status.h"
+#include <atomic>
 #include <cstdint>
 #include <list>
 #include <memory>
+#include <mutex>
 #include <unistd.h>
+#include <vector>
 
 namespace rangedb {
 namespace storage {
@@ -21,7 +25,7 @@ public:
         file_id_ = file_id;
         file_name_ = std::to_string(file_id) + ".sst";
         block_manager_ = BlockManager::GetInstance();
-        file_handle_ = FileManager::GetInstance()->CreateFile(file_name_);
+        file_handle_ = FileManager::GetInstance()->CreateFile(file_name_, SST_DIRECT_IO);
     }
     ~SstBlockFile() {}
     storage::BlockPtr AddBlock();
@@ -29,16 +33,49 @@ public:
     // Read data from file
     BlockPtr ReadBlock(size_t inner_block_id);
 
+    // Block from the block cache, read from file and inserted with hint on a miss.
+    // Concurrent misses on the same block share one read.
+    BlockPtr GetBlock(size_t inner_block_id, CacheHint hint);
+
+    // Same as GetBlock, a block cache hit is pinned by the reader's epoch, see BlockHandle
+    BlockHandle PinBlock(size_t inner_block_id, CacheHint hint);
+
+    // Read only the 4KB pages holding the record of length bytes at offset of the
+    // inner block, returns the record bytes without the page padding
+    RecordPtr ReadRecord(size_t inner_block_id, uint64_t offset, uint32_t length);
+
+    // Read count contiguous blocks with one preadv, returns the number of blocks read
+    size_t ReadBlocks(size_t start_block_id, size_t count, std::vector<BlockPtr> *blocks);
+
+    // Offset of the inner block in the sst file, blocks start right after the file header
+    static inline off64_t GetBlockOffset(size_t inner_block_id) { return SST_BLOCKFILE_HEADER_SIZE + inner_block_id * BLOCK_SIZE; }
+
+    inline FileHandlePtr GetFileHandle() { return file_handle_; }
+
     inline int GetBlockNum() override { return block_num_; }
 
     StatusCode Append(Slice *source) override;
 
     Status Flush() override;
 
+    // The blocks no more appended to, every block but the last one. They leave the blocks
+    // Flush writes, the caller writes them with WriteBlocks.
+    std::vector<BlockPtr> TakeFullBlocks();
+
+    // Finish blocks and write them from inner block first_block_id on, without the header
+    // and without a sync, Flush writes the header and syncs the file
+    Status WriteBlocks(size_t first_block_id, const std::vector<BlockPtr> &blocks);
+
     Status InitFromData(int8_t *data) override;
 
+    // Point lookup of source->key_ in the block whose key range holds it
+    Status Get(Slice *source);
+
+    // Iterators are scans, the blocks they read are cached with LOW_PRIORITY
     Iterator *NewIterator(const Comparator *comparator) override;
 
+    Iterator *NewIterator(const Comparator *comparator, CacheHint hint);
+
     ByteKey GetMinKey() override { return file_min_key_; }
 
     ByteKey GetMaxKey() override { return file_max_key_; }
@@ -51,17 +88,32 @@ public:
 private:
     class Iter;
 
+    // Block number and block min keys from the file header, block_num_ is published last
+    void ParseHeader(const int8_t *data);
+
+    Status ReadHeader();
+
+    // Read the header once for the concurrent first Gets of a file opened for reads
+    Status LoadHeader();
+
+    // Read the block once for all concurrent misses and add it to the block cache
+    BlockPtr LoadBlock(size_t inner_block_id, CacheHint hint);
+
 private:
     uint64_t file_id_;
     std::string file_name_;
     std::list<storage::BlockPtr> block_list_;
-    uint32_t block_num_ = 0;
+    // 0 until the blocks are appended or the header is loaded, see LoadHeader
+    std::atomic<uint32_t> block_num_{0};
+    std::mutex header_mutex_;
     uint64_t cur_append_block_id_ = 0;
     FileHandlePtr file_handle_;
     BlockManagerPtr block_manager_;
     ByteKey file_max_key_;
     ByteKey file_min_key_;
     std::vector<ByteKey> block_min_key_vec_;
+    // block cache misses being read, keyed by inner block id
+    SingleFlight<size_t, BlockPtr> inflight_reads_;
 };
 using SstBlockFilePtr = std::shared_ptr<SstBlockFile>;
 } // namespace storage
@@ -11,33 +11,20 @@
 
 #pragma once
 
-#include <memory>
-#include <string>
-#include <unordered_map>
-#include <vector>
+#include <cstdint>
 
 namespace rangedb {
 namespace storage {
 
-#define UNIT_MB (1024 * 1024)
-#define UNIT_B 1
-#define LSN_OFFSET_MASK 0x00000000ffffffff
-
-enum class MXLogType { None, Put, Delete, Flush };
-
-struct MXLogRecord {
-    uint64_t lsn;
-    MXLogType type;
-    std::string database;
-    uint32_t data_size;
-    const void *data = nullptr;
+// how far a record has to get before an append returns
+enum class MXLogDurability {
+    Buffered, // appended to the memtable block, written and synced by the background syncer
+    Written,  // written to the wal block file, survives a process crash
+    Synced,   // fdatasynced, survives a machine crash
 };
 
-struct MXLogConfiguration {
-    bool recovery_error_ignore;
-    uint32_t buffer_size;
-    std::string mxlog_path;
-};
+// the syncer fdatasyncs the buffered records at least this often, the loss window of buffered writes
+const uint64_t MXLOG_SYNC_INTERVAL_MS = 10;
 
 } // namespace storage
 } // namespace rangedb
@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "storage/walblock/WalBlock.h"
 #include "utils/Comparator.h"
 #include "utils/Iterator.h"
@@ -27,7 +29,7 @@ public:
             value_.Deserialize((int8_t *)data + offset);
             key_ = value_.key_;
             key_offset_[key_] = offset;
-            offset += value_.Size();
+            offset += RecordSize(value_);
         }
     }
     Status status() const override { return status_; }
@@ -91,6 +93,28 @@ private:
     }
 };
 
+bool WalBlock::KeyLess(const WalRecordRef &ref, const WalBlock &other, const WalRecordRef &other_ref) const {
+    if (ref.prefix_ != other_ref.prefix_) {
+        return ref.prefix_ < other_ref.prefix_;
+    }
+    // equal prefixes are keys of the same length
+    uint32_t key_length = uint32_t(ref.prefix_ >> 56);
+    if (key_length <= 7) {
+        return false;
+    }
+    return std::memcmp(data_ + ref.offset_ + RECORD_KEY_OFFSET + 7, other.data_ + other_ref.offset_ + RECORD_KEY_OFFSET + 7,
+                       key_length - 7) < 0;
+}
+
+void WalBlock::SortRecordRefs() {
+    if (refs_sorted_) {
+        return;
+    }
+    refs_sorted_ = true;
+    std::stable_sort(record_refs_.begin(), record_refs_.end(),
+                     [this](const WalRecordRef &a, const WalRecordRef &b) { return KeyLess(a, *this, b); });
+}
+
 Iterator *WalBlock::NewIterator(const Comparator *comparator) { return new Iter(comparator, (int8_t *)data_, write_offset_); }
 
 } // namespace storage
@@ -4,14 +4,47 @@
 #include "utils/Comparator.h"
 #include "utils/Iterator.h"
 #include "utils/Slice.h"
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <cstring>
 #include <iostream>
 #include <ostream>
 #include <unistd.h>
+#include <vector>
 namespace rangedb {
 namespace storage {
+// offsets of the fields checked by recovery in a serialized slice, see Slice::Serialize
+const size_t RECORD_BLOCK_ID_OFFSET = sizeof(uint32_t) + sizeof(uint64_t) * 2;
+const size_t RECORD_OFFSET_OFFSET = RECORD_BLOCK_ID_OFFSET + sizeof(uint32_t) + sizeof(uint8_t);
+const size_t RECORD_KEY_OFFSET = SLICE_HEADER_SIZE + sizeof(uint32_t) + sizeof(int64_t);
+// a record is its serialized slice followed by a trailer: the records left in its write batch,
+// itself included, 1 for a put, the sequence of a write batch spanning memtables, 0 for the
+// others, and the XXH64 of the slice, that count and the sequence. Recovery stops at the first
+// record that does not match and drops a batch whose last record is missing.
+const size_t RECORD_BATCH_LEFT_SIZE = sizeof(uint32_t);
+const size_t RECORD_SEQ_SIZE = sizeof(uint64_t);
+const size_t RECORD_TRAILER_SIZE = RECORD_BATCH_LEFT_SIZE + RECORD_SEQ_SIZE + sizeof(uint64_t);
+
+// Bytes slice takes in a wal block
+inline size_t RecordSize(const Slice &slice) { return slice.Size() + RECORD_TRAILER_SIZE; }
+
+// A record in the sorted run of its block, prefix orders keys as ByteKey does: the length in
+// the top byte, then the first 7 key bytes, so most compares never touch the block data
+struct WalRecordRef {
+    uint64_t prefix_;
+    uint32_t block_id_;
+    uint32_t offset_;
+};
+
+inline uint64_t KeyPrefix(const int8_t *key_data, uint32_t key_length) {
+    uint64_t prefix = uint64_t(key_length) << 56;
+    for (uint32_t i = 0; i < 7 && i < key_length; i++) {
+        prefix |= uint64_t(uint8_t(key_data[i])) << (48 - i * 8);
+    }
+    return prefix;
+}
+
 struct WalBlockHeader {
     uint32_t write_offset_;
 };
@@ -24,18 +57,30 @@ public:
         write_offset_ += sizeof(block_id_);
     }
 
-    ~WalBlock() {
-        std::cout << "block_id: " << block_id_ << " already freeed" << std::endl;
-        // delete data_;
-    }
+    ~WalBlock() { delete[] data_; }
 
-    void Append(Slice *slice) {
+    WalBlock(const WalBlock &) = delete;
+    WalBlock &operator=(const WalBlock &) = delete;
+
+    void Append(Slice *slice) { Append(slice, 1, 0); }
+
+    // batch_left is the number of records of the write batch of slice still to append, itself
+    // included, seq the sequence of a batch spanning memtables or 0
+    void Append(Slice *slice, uint32_t batch_left, uint64_t seq) {
         slice->offset_ = write_offset_;
         slice->block_id_ = block_id_;
         slice->block_type_ = 0;
         slice->data_length_ = slice->Size();
         slice->Serialize(data_ + write_offset_);
-        write_offset_ += slice->Size();
+        int8_t *trailer = data_ + write_offset_ + slice->data_length_;
+        std::memcpy(trailer, &batch_left, RECORD_BATCH_LEFT_SIZE);
+        std::memcpy(trailer + RECORD_BATCH_LEFT_SIZE, &seq, RECORD_SEQ_SIZE);
+        uint64_t checksum = XXH64(data_ + write_offset_, slice->data_length_ + RECORD_BATCH_LEFT_SIZE + RECORD_SEQ_SIZE, 0);
+        std::memcpy(trailer + RECORD_BATCH_LEFT_SIZE + RECORD_SEQ_SIZE, &checksum, sizeof(checksum));
+        refs_sorted_ = false;
+        uint64_t prefix = KeyPrefix(slice->key_.data_, slice->key_.length_);
+        record_refs_.push_back(WalRecordRef{prefix, uint32_t(block_id_), uint32_t(write_offset_)});
+        write_offset_ += RecordSize(*slice);
         assert(write_offset_ <= BLOCK_SIZE);
     }
 
@@ -51,12 +96,103 @@ public:
 
     void Finshed() {}
 
+    // A record at offset was appended to this block, the bytes past the last record of a
+    // recovered block are zeros of the preallocated file or a torn append
+    bool IsValidRecord(const int8_t *data, size_t offset) const {
+        if (offset + SLICE_HEADER_SIZE + sizeof(uint32_t) > BLOCK_SIZE) {
+            return false;
+        }
+        Slice head;
+        std::memcpy(&head.data_length_, data + offset, sizeof(head.data_length_));
+        std::memcpy(&head.block_id_, data + offset + RECORD_BLOCK_ID_OFFSET, sizeof(head.block_id_));
+        std::memcpy(&head.offset_, data + offset + RECORD_OFFSET_OFFSET, sizeof(head.offset_));
+        std::memcpy(&head.key_.length_, data + offset + SLICE_HEADER_SIZE, sizeof(head.key_.length_));
+        if (head.block_id_ != block_id_ || head.offset_ != offset || head.key_.length_ > sizeof(head.key_.data_) ||
+            head.data_length_ < SLICE_HEADER_SIZE + head.key_.Size() || offset + head.data_length_ + RECORD_TRAILER_SIZE > BLOCK_SIZE) {
+            return false;
+        }
+        uint64_t checksum = 0;
+        std::memcpy(&checksum, data + offset + head.data_length_ + RECORD_BATCH_LEFT_SIZE + RECORD_SEQ_SIZE, sizeof(checksum));
+        return checksum == XXH64(data + offset, head.data_length_ + RECORD_BATCH_LEFT_SIZE + RECORD_SEQ_SIZE, 0);
+    }
+
+    // Bytes of the record at offset with its trailer
+    size_t GetRecordSize(size_t offset) const {
+        uint32_t data_length = 0;
+        std::memcpy(&data_length, data_ + offset, sizeof(data_length));
+        return data_length + RECORD_TRAILER_SIZE;
+    }
+
+    // The records of the write batch of the record at offset left to append when it was, 1 for a put
+    uint32_t GetBatchLeft(size_t offset) const {
+        uint32_t data_length = 0;
+        uint32_t batch_left = 0;
+        std::memcpy(&data_length, data_ + offset, sizeof(data_length));
+        std::memcpy(&batch_left, data_ + offset + data_length, RECORD_BATCH_LEFT_SIZE);
+        return batch_left;
+    }
+
+    // The sequence of the write batch of the record at offset if it spans memtables, else 0
+    uint64_t GetSeq(size_t offset) const {
+        uint32_t data_length = 0;
+        uint64_t seq = 0;
+        std::memcpy(&data_length, data_ + offset, sizeof(data_length));
+        std::memcpy(&seq, data_ + offset + data_length + RECORD_BATCH_LEFT_SIZE, RECORD_SEQ_SIZE);
+        return seq;
+    }
+
+    // Drop the records of a recovered block from offset on, they belong to a batch not
+    // recovered whole
+    void Truncate(size_t offset) {
+        std::memset(data_ + offset, 0, write_offset_ - offset);
+        write_offset_ = offset;
+        record_refs_.erase(std::remove_if(record_refs_.begin(), record_refs_.end(),
+                                          [offset](const WalRecordRef &ref) { return ref.offset_ >= offset; }),
+                           record_refs_.end());
+    }
+
     bool IsFull() const { return write_offset_ + 128 >= BLOCK_SIZE; }
 
     inline size_t GetSize() const { return write_offset_; }
     inline uint64_t GetBlockId() const { return block_id_; }
     const int8_t *GetData() const { return data_; }
-    void InitFromData(int8_t *data) { std::memcpy(&write_offset_, data, sizeof(write_offset_)); }
+
+    // The records in append order, sorted by key once SortRecordRefs ran
+    const std::vector<WalRecordRef> &GetRecordRefs() const { return record_refs_; }
+
+    // Sort the records of the block by key, the ones of a key stay in append order; called
+    // once the block takes no more appends
+    void SortRecordRefs();
+
+    // The key of a record ref of this block comes before the key of other, which may be of another block
+    bool KeyLess(const WalRecordRef &ref, const WalBlock &other, const WalRecordRef &other_ref) const;
+
+    // Copy a block read from its wal block file, the records run up to the first invalid one
+    void InitFromData(int8_t *data) {
+        std::memcpy(data_, data, BLOCK_SIZE);
+        write_offset_ = HEAD_SIZE + sizeof(block_id_);
+        record_refs_.clear();
+        refs_sorted_ = false;
+        while (IsValidRecord(data_, write_offset_)) {
+            uint32_t record_size = 0;
+            uint32_t key_length = 0;
+            std::memcpy(&record_size, data_ + write_offset_, sizeof(record_size));
+            std::memcpy(&key_length, data_ + write_offset_ + SLICE_HEADER_SIZE, sizeof(key_length));
+            record_refs_.push_back(WalRecordRef{KeyPrefix(data_ + write_offset_ + RECORD_KEY_OFFSET, key_length), uint32_t(block_id_),
+                                                uint32_t(write_offset_)});
+            write_offset_ += record_size + RECORD_TRAILER_SIZE;
+        }
+    }
+
+    // The records of a recovered block end at a torn or corrupt record instead of the zeros
+    // past the last one
+    bool HasBadRecord() const {
+        uint32_t record_size = 0;
+        if (write_offset_ + sizeof(record_size) <= BLOCK_SIZE) {
+            std::memcpy(&record_size, data_ + write_offset_, sizeof(record_size));
+        }
+        return record_size != 0;
+    }
     void Serialize(int8_t *buffer) const { std::memcpy(data_, &write_offset_, sizeof(write_offset_)); }
     Iterator *NewIterator(const Comparator *comparator);
 
@@ -69,6 +205,8 @@ private:
     uint64_t block_id_;
     ByteKey max_key_;
     ByteKey min_key_;
+    std::vector<WalRecordRef> record_refs_;
+    bool refs_sorted_ = false;
 };
 
 using WalBlockPtr = std::shared_ptr<WalBlock>;
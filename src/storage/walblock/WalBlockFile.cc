@@ -9,11 +9,18 @@
 // is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
 // or implied. See the License for the specific language governing permissions and limitations under the License.
 
+#include <algorithm>
 #include <cassert>
+#include <cerrno>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
 #include <queue>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <vector>
 
 #include "storage/block/Block.h"
@@ -28,8 +35,58 @@
 namespace rangedb {
 WalBlockFile::WalBlockFile(uint64_t file_id) : file_id_(file_id) {}
 
+Status WalBlockFile::Open() {
+    FileHandlePtr file_handle = std::make_shared<FileHandle>(std::to_string(file_id_) + ".wal");
+    if (!file_handle->Open()) {
+        return Status(DB_WRITE_BLOCK_ERROR, "open wal block file failed");
+    }
+    // the syncer may sync the file while the first record opens it
+    std::lock_guard<std::mutex> lock(sync_mutex_);
+    file_handle_ = file_handle;
+    return Status::OK();
+}
+
+Status WalBlockFile::Load() {
+    FileHandlePtr file_handle = std::make_shared<FileHandle>(std::to_string(file_id_) + ".wal");
+    struct stat file_stat;
+    if (!file_handle->Open() || fstat(file_handle->GetFd(), &file_stat) != 0) {
+        return Status(DB_READ_BLOCK_ERROR, "open wal block file failed");
+    }
+    size_t file_size = file_stat.st_size;
+    block_num_ = (file_size + storage::BLOCK_SIZE - 1) / storage::BLOCK_SIZE;
+    auto data = std::make_unique<int8_t[]>(block_num_ * storage::BLOCK_SIZE);
+    std::memset(data.get(), 0, block_num_ * storage::BLOCK_SIZE);
+    if (file_size > 0 && !file_handle->Read(data.get(), file_size, 0)) {
+        file_handle->Close();
+        return Status(DB_READ_BLOCK_ERROR, "read wal block file failed");
+    }
+    file_handle->Close();
+    return InitFromData(data.get());
+}
+
+void WalBlockFile::DeleteFile() {
+    std::lock_guard<std::mutex> lock(sync_mutex_);
+    if (file_handle_ != nullptr) {
+        file_handle_->Close();
+        file_handle_ = nullptr;
+    }
+    unlink((std::to_string(file_id_) + ".wal").c_str());
+}
+
 storage::BlockPtr WalBlockFile::AddBlock() {
     assert(block_num_ < storage::MAX_BLOCK_NUM);
+    if (file_handle_ != nullptr && preallocate_) {
+        // appends within the block do not change the file size, fdatasync skips the metadata
+        if (fallocate(file_handle_->GetFd(), 0, block_num_ * storage::BLOCK_SIZE, storage::BLOCK_SIZE) != 0) {
+            // the file grows with the writes instead, their errors reach the writers
+            std::cout << "preallocate wal block file " << file_id_ << " failed: " << strerror(errno) << std::endl;
+            preallocate_ = false;
+        }
+    }
+    if (!block_list_.empty()) {
+        // the last block is full, its run is sorted while it is hot in the cache
+        std::dynamic_pointer_cast<storage::WalBlock>(block_list_.back())->SortRecordRefs();
+    }
     auto new_block = std::make_shared<storage::WalBlock>(block_num_);
     block_list_.emplace_back(new_block);
     block_num_++;
@@ -41,22 +98,36 @@ StatusCode WalBlockFile::Append(Slice *source, uint32_t db_block_id) {
         AddBlock();
     }
     auto block = block_list_.back();
-    if (storage::BLOCK_SIZE - block->GetSize() < source->Size()) {
+    if (storage::BLOCK_SIZE - block->GetSize() < storage::RecordSize(*source)) {
         block = AddBlock();
     }
     block->Append(source);
     return DB_SUCCESS;
 }
 
-StatusCode WalBlockFile::Append(Slice *source) {
+StatusCode WalBlockFile::Append(Slice *source) { return AppendRecord(source, 1, 0); }
+
+StatusCode WalBlockFile::AppendBatch(std::vector<Slice> &sources, uint64_t seq) {
+    for (size_t i = 0; i < sources.size(); i++) {
+        StatusCode code = AppendRecord(&sources[i], sources.size() - i, seq);
+        if (code != DB_SUCCESS) {
+            return code;
+        }
+    }
+    return DB_SUCCESS;
+}
+
+StatusCode WalBlockFile::AppendRecord(Slice *source, uint32_t batch_left, uint64_t seq) {
     if (block_list_.empty()) {
         AddBlock();
     }
-    auto block = block_list_.back();
-    if (storage::BLOCK_SIZE - block->GetSize() < source->Size()) {
-        block = AddBlock();
+    auto block = std::dynamic_pointer_cast<storage::WalBlock>(block_list_.back());
+    if (storage::BLOCK_SIZE - block->GetSize() < storage::RecordSize(*source)) {
+        block = std::dynamic_pointer_cast<storage::WalBlock>(AddBlock());
     }
-    block->Append(source);
+    // the record carries its position, recovery rebuilds the index from it
+    source->file_id_ = file_id_;
+    block->Append(source, batch_left, seq);
     return DB_SUCCESS;
 }
 
@@ -75,25 +146,311 @@ storage::BlockPtr WalBlockFile::ReadBlock(uint32_t block_id) {
     return block;
 }
 
+Status WalBlockFile::Write() {
+    if (file_handle_ == nullptr) {
+        return Status::OK();
+    }
+    for (; written_block_ < block_list_.size(); written_block_++, written_offset_ = 0) {
+        auto block = block_list_[written_block_];
+        size_t size = block->GetSize();
+        if (size > written_offset_) {
+            if (!file_handle_->WriteAt(block->GetData() + written_offset_, size - written_offset_,
+                                       written_block_ * storage::BLOCK_SIZE + written_offset_)) {
+                return Status(DB_WRITE_BLOCK_ERROR, "write wal block file failed");
+            }
+            written_offset_ = size;
+        }
+        if (written_block_ + 1 == block_list_.size()) {
+            // the last block takes more appends
+            break;
+        }
+    }
+    return Status::OK();
+}
+
+Status WalBlockFile::Sync() {
+    std::lock_guard<std::mutex> lock(sync_mutex_);
+    if (file_handle_ != nullptr && fdatasync(file_handle_->GetFd()) != 0) {
+        return Status(DB_WRITE_BLOCK_ERROR, "sync wal block file failed");
+    }
+    return Status::OK();
+}
+
 Status WalBlockFile::Flush() {
-    Status status;
-    return status;
+    Status status = Write();
+    if (!status.ok()) {
+        return status;
+    }
+    return Sync();
+}
+
+uint64_t WalBlockFile::GetEndOffset() {
+    if (block_list_.empty()) {
+        return 0;
+    }
+    return (block_list_.size() - 1) * storage::BLOCK_SIZE + block_list_.back()->GetSize();
+}
+
+size_t WalBlockFile::GetRecordNum() {
+    size_t record_num = 0;
+    for (auto &block : block_list_) {
+        record_num += std::dynamic_pointer_cast<storage::WalBlock>(block)->GetRecordRefs().size();
+    }
+    return record_num;
+}
+
+void WalBlockFile::ForEachRecord(const std::function<void(Slice *)> &apply) {
+    for (uint32_t block_id = 0; block_id < block_list_.size(); block_id++) {
+        ForEachRecord(block_id, apply);
+    }
+}
+
+void WalBlockFile::ForEachRecord(uint32_t block_id, const std::function<void(Slice *)> &apply) {
+    auto &block = block_list_[block_id];
+    size_t offset = storage::HEAD_SIZE + sizeof(uint64_t);
+    while (offset < block->GetSize()) {
+        Slice slice;
+        slice.offset_ = offset;
+        block->Read(&slice);
+        apply(&slice);
+        offset += slice.data_length_ + storage::RECORD_TRAILER_SIZE;
+    }
 }
 
 Status WalBlockFile::InitFromData(int8_t *data) {
+    // block_num_ blocks of BLOCK_SIZE, as Load read them
     uint32_t offset = 0;
-    std::memcpy(&block_num_, data + offset, sizeof(uint32_t));
-    offset += sizeof(uint32_t);
+    std::vector<std::shared_ptr<storage::WalBlock>> blocks;
     for (int i = 0; i < block_num_; i++) {
         auto block = std::make_shared<storage::WalBlock>(i);
         block->InitFromData(data + offset);
-        block_list_.emplace_back(block);
-        BlockManager::GetInstance()->AddBlockCache(file_id_, i, block);
+        blocks.push_back(block);
         offset += storage::BLOCK_SIZE;
+        if (block->HasBadRecord()) {
+            // the records after a torn or corrupt one are not replayed
+            std::cout << "wal block file " << file_id_ << " block " << i << " has a bad record at " << block->GetSize()
+                      << ", recovered up to it" << std::endl;
+            break;
+        }
+    }
+    block_num_ = TruncateBatchTail(blocks);
+    for (uint32_t i = 0; i < block_num_; i++) {
+        block_list_.emplace_back(blocks[i]);
+        BlockManager::GetInstance()->AddBlockCache(file_id_, i, blocks[i]);
     }
     return Status::OK();
 }
 
+size_t WalBlockFile::TruncateBatchTail(const std::vector<std::shared_ptr<storage::WalBlock>> &blocks) {
+    // the end of the records of the whole batches
+    size_t keep_block = 0;
+    size_t keep_offset = storage::HEAD_SIZE + sizeof(uint64_t);
+    // records the last batch misses
+    uint32_t missing = 0;
+    bool bad_record = false;
+    for (size_t i = 0; i < blocks.size() && !bad_record; i++) {
+        for (auto &ref : blocks[i]->GetRecordRefs()) {
+            uint32_t batch_left = blocks[i]->GetBatchLeft(ref.offset_);
+            // the next record of the last batch or the first of a new one
+            if (missing > 0 ? batch_left != missing : batch_left == 0) {
+                bad_record = true;
+                break;
+            }
+            missing = batch_left - 1;
+            if (missing == 0) {
+                keep_block = i;
+                keep_offset = ref.offset_ + blocks[i]->GetRecordSize(ref.offset_);
+            }
+        }
+    }
+    if (missing == 0 && !bad_record) {
+        return blocks.size();
+    }
+    std::cout << "wal block file " << file_id_ << " ends in a write batch not recovered whole, recovered up to block " << keep_block
+              << " offset " << keep_offset << std::endl;
+    if (!blocks.empty()) {
+        blocks[keep_block]->Truncate(keep_offset);
+    }
+    return blocks.empty() ? 0 : keep_block + 1;
+}
+
+uint64_t WalBlockFile::GetLastSeq() {
+    for (size_t i = block_list_.size(); i > 0; i--) {
+        auto block = std::dynamic_pointer_cast<storage::WalBlock>(block_list_[i - 1]);
+        size_t offset = storage::HEAD_SIZE + sizeof(uint64_t);
+        if (offset >= block->GetSize()) {
+            continue;
+        }
+        while (offset + block->GetRecordSize(offset) < block->GetSize()) {
+            offset += block->GetRecordSize(offset);
+        }
+        return block->GetSeq(offset);
+    }
+    return 0;
+}
+
+Status WalBlockFile::DropLastBatch() {
+    // the first record of the last batch, the records are walked in append order
+    size_t start_block = 0;
+    size_t start_offset = 0;
+    uint32_t missing = 0;
+    bool found = false;
+    for (size_t i = 0; i < block_list_.size(); i++) {
+        auto block = std::dynamic_pointer_cast<storage::WalBlock>(block_list_[i]);
+        for (size_t offset = storage::HEAD_SIZE + sizeof(uint64_t); offset < block->GetSize(); offset += block->GetRecordSize(offset)) {
+            if (missing == 0) {
+                start_block = i;
+                start_offset = offset;
+                found = true;
+            }
+            missing = block->GetBatchLeft(offset) - 1;
+        }
+    }
+    if (!found) {
+        return Status::OK();
+    }
+    for (size_t i = block_list_.size(); i > start_block; i--) {
+        auto block = std::dynamic_pointer_cast<storage::WalBlock>(block_list_[i - 1]);
+        block->Truncate(i - 1 == start_block ? start_offset : storage::HEAD_SIZE + sizeof(uint64_t));
+    }
+    sorted_ = false;
+    // a restart after this one must not find the batch again
+    FileHandle file_handle(std::to_string(file_id_) + ".wal");
+    if (!file_handle.Open()) {
+        return Status(DB_WRITE_BLOCK_ERROR, "open wal block file failed");
+    }
+    int result = ftruncate(file_handle.GetFd(), start_block * storage::BLOCK_SIZE + start_offset);
+    if (result == 0) {
+        result = fsync(file_handle.GetFd());
+    }
+    file_handle.Close();
+    if (result != 0) {
+        return Status(DB_WRITE_BLOCK_ERROR, "truncate wal block file failed");
+    }
+    return Status::OK();
+}
+
+void WalBlockFile::SortRecords() {
+    if (sorted_) {
+        return;
+    }
+    std::vector<storage::WalBlock *> blocks;
+    std::vector<size_t> run_ends;
+    size_t record_num = 0;
+    for (auto &block : block_list_) {
+        blocks.push_back(dynamic_cast<storage::WalBlock *>(block.get()));
+        record_num += blocks.back()->GetRecordRefs().size();
+    }
+    sorted_refs_.clear();
+    sorted_refs_.reserve(record_num);
+    for (auto block : blocks) {
+        block->SortRecordRefs();
+        sorted_refs_.insert(sorted_refs_.end(), block->GetRecordRefs().begin(), block->GetRecordRefs().end());
+        run_ends.push_back(sorted_refs_.size());
+    }
+
+    auto less = [&blocks](const storage::WalRecordRef &a, const storage::WalRecordRef &b) {
+        return blocks[a.block_id_]->KeyLess(a, *blocks[b.block_id_], b);
+    };
+    // merge neighbouring runs until one is left, the merge is stable so the records of a key
+    // stay in append order
+    while (run_ends.size() > 1) {
+        std::vector<size_t> merged_ends;
+        size_t start = 0;
+        for (size_t i = 0; i < run_ends.size(); i += 2) {
+            if (i + 1 < run_ends.size()) {
+                std::inplace_merge(sorted_refs_.begin() + start, sorted_refs_.begin() + run_ends[i], sorted_refs_.begin() + run_ends[i + 1],
+                                   less);
+                start = run_ends[i + 1];
+            } else {
+                start = run_ends[i];
+            }
+            merged_ends.push_back(start);
+        }
+        run_ends.swap(merged_ends);
+    }
+
+    // keep the last record of a key, the index points to it
+    size_t kept = 0;
+    for (size_t i = 0; i < sorted_refs_.size(); i++) {
+        if (i + 1 < sorted_refs_.size() && !less(sorted_refs_[i], sorted_refs_[i + 1])) {
+            continue;
+        }
+        sorted_refs_[kept++] = sorted_refs_[i];
+    }
+    sorted_refs_.resize(kept);
+    sorted_ = true;
+}
+
+class WalBlockFile::SortedIter : public Iterator {
+private:
+    const std::vector<storage::WalRecordRef> &refs_;
+    std::vector<storage::BlockPtr> block_list_;
+    size_t pos_;
+    Slice value_;
+    Status status_;
+
+    void ParseRecord() {
+        if (pos_ < refs_.size()) {
+            auto &ref = refs_[pos_];
+            value_.Deserialize(const_cast<int8_t *>(block_list_[ref.block_id_]->GetData()) + ref.offset_);
+        }
+    }
+
+    // The key of ref comes before target
+    bool RefLess(const storage::WalRecordRef &ref, const ByteKey &target, uint64_t target_prefix) const {
+        if (ref.prefix_ != target_prefix) {
+            return ref.prefix_ < target_prefix;
+        }
+        if (target.length_ <= 7) {
+            return false;
+        }
+        const int8_t *key_data = block_list_[ref.block_id_]->GetData() + ref.offset_ + storage::RECORD_KEY_OFFSET;
+        return std::memcmp(key_data + 7, target.data_ + 7, target.length_ - 7) < 0;
+    }
+
+public:
+    SortedIter(const std::vector<storage::WalRecordRef> &refs, const std::vector<storage::BlockPtr> &block_list)
+        : refs_(refs), block_list_(block_list), pos_(refs.size()) {}
+
+    bool Valid() const override { return pos_ < refs_.size(); }
+    Status status() const override { return status_; }
+    bool End() const override { return pos_ >= refs_.size(); }
+
+    void SeekToFirst() override {
+        pos_ = 0;
+        ParseRecord();
+    }
+
+    void SeekToLast() override {
+        pos_ = refs_.empty() ? 0 : refs_.size() - 1;
+        ParseRecord();
+    }
+
+    void Seek(const ByteKey &target) override {
+        uint64_t target_prefix = storage::KeyPrefix(target.data_, target.length_);
+        auto it = std::lower_bound(refs_.begin(), refs_.end(), target,
+                                   [this, target_prefix](const storage::WalRecordRef &ref, const ByteKey &key) {
+                                       return RefLess(ref, key, target_prefix);
+                                   });
+        pos_ = it - refs_.begin();
+        ParseRecord();
+    }
+
+    void Next() override {
+        pos_++;
+        ParseRecord();
+    }
+
+    void Prev() override {
+        pos_ = pos_ == 0 ? refs_.size() : pos_ - 1;
+        ParseRecord();
+    }
+
+    ByteKey Key() const override { return value_.key_; }
+    Slice Value() const override { return value_; }
+};
+
 class WalBlockFile::Iter : public Iterator {
 private:
     struct cmp {
@@ -205,6 +562,11 @@ private:
     }
 };
 
-Iterator *WalBlockFile::NewIterator(const Comparator *comparator) { return new Iter(comparator, block_list_); }
+Iterator *WalBlockFile::NewIterator(const Comparator *comparator) {
+    if (sorted_) {
+        return new SortedIter(sorted_refs_, block_list_);
+    }
+    return new Iter(comparator, block_list_);
+}
 
 } // namespace rangedb
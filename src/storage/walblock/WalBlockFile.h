@@ -12,32 +12,92 @@
 #pragma once
 
 #include <cstdint>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <sys/types.h>
 #include <vector>
 
 #include "storage/block/Block.h"
 #include "storage/block/BlockFile.h"
+#include "storage/walblock/WalBlock.h"
+#include "utils/FileHandle.h"
 #include "utils/Slice.h"
 #include "utils/Status.h"
 
 namespace rangedb {
+// WalBlockFile is a memtable and its write ahead log at once: the serialized records of
+// its blocks are written as they are to <file_id>.wal, block i at i * BLOCK_SIZE, so
+// recovery reads the blocks back instead of replaying a separate log. Without Open the
+// file only lives in memory.
 class WalBlockFile : virtual public storage::BlockFile {
 public:
     WalBlockFile(uint64_t file_id);
-    ~WalBlockFile() = default;
+    ~WalBlockFile() {
+        if (file_handle_ != nullptr) {
+            file_handle_->Close();
+        }
+    }
 
 public:
+    // Create the file of a new memtable
+    Status Open();
+
+    // Read the blocks of the file written before a restart
+    Status Load();
+
+    // Remove the file once its records are in an sst file, the blocks stay readable; waits for
+    // a Sync running on another thread
+    void DeleteFile();
+
+    bool IsOpen() const { return file_handle_ != nullptr; }
+
     storage::BlockPtr AddBlock();
 
     StatusCode Append(Slice *source, uint32_t cur_block_id);
 
     StatusCode Append(Slice *source) override;
 
+    // Append the records of a write batch back to back, recovery keeps all of them or none; seq
+    // is the sequence of a batch spanning memtables, 0 for a batch within this one
+    StatusCode AppendBatch(std::vector<Slice> &sources, uint64_t seq = 0);
+
+    // Write the records appended since the last Write, the caller serializes it with Append
+    Status Write();
+
+    // fdatasync the records written, safe to call while records are appended or the file is
+    // deleted
+    Status Sync();
+
+    // Write and Sync
     Status Flush() override;
 
+    // End of the records appended, block i ends at i * BLOCK_SIZE + its size
+    uint64_t GetEndOffset();
+
+    // Call apply on every record in the order they were appended
+    void ForEachRecord(const std::function<void(Slice *)> &apply);
+
+    // Call apply on every record of block block_id in the order they were appended, blocks
+    // may be walked from several threads at once
+    void ForEachRecord(uint32_t block_id, const std::function<void(Slice *)> &apply);
+
+    // The sequence of the last record of a recovered file, 0 if its batch is within the file
+    uint64_t GetLastSeq();
+
+    // Drop the last write batch of a recovered file, from the blocks and from the file
+    Status DropLastBatch();
+
+    // Merge the sorted runs of the blocks into the records of the file in key order, the newest
+    // record of a key only; called once the file takes no more appends, its iterator then walks
+    // the sorted records instead of merging the blocks
+    void SortRecords();
+
     int GetBlockNum() override { return block_num_; }
 
+    // Records appended or recovered
+    size_t GetRecordNum();
+
     size_t remind();
 
     storage::BlockPtr ReadBlock(uint32_t block_id);
@@ -52,6 +112,12 @@ public:
 
 private:
     class Iter;
+    class SortedIter;
+
+    StatusCode AppendRecord(Slice *source, uint32_t batch_left, uint64_t seq);
+
+    // Drop the records after the last write batch recovered whole, returns the blocks left
+    size_t TruncateBatchTail(const std::vector<std::shared_ptr<storage::WalBlock>> &blocks);
 
 private:
     uint64_t file_id_;
@@ -62,6 +128,17 @@ private:
     std::array<ByteKey, storage::MAX_BLOCK_NUM> bloc_key_range_;
     ByteKey file_max_key_;
     ByteKey file_min_key_;
+    FileHandlePtr file_handle_;
+    // held by Sync across the fdatasync and by DeleteFile to close the file, so a sync never
+    // runs on a descriptor closed and given to another file meanwhile
+    std::mutex sync_mutex_;
+    // records before written_offset_ of block written_block_ are in the file
+    uint32_t written_block_ = 0;
+    size_t written_offset_ = 0;
+    // cleared once fallocate failed, the file then grows with the writes
+    bool preallocate_ = true;
+    std::vector<storage::WalRecordRef> sorted_refs_;
+    bool sorted_ = false;
 }; // WalBlockFile
 using WalBlockFilePtr = std::shared_ptr<WalBlockFile>;
 } // namespace rangedb
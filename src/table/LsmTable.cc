@@ -2,31 +2,119 @@
 #include "storage/block/Block.h"
 #include "storage/sstblock/SstBlockFile.h"
 #include "storage/walblock/WalBlock.h"
+#include "utils/BoundedQueue.h"
 #include "utils/Iterator.h"
 #include "utils/Manifest.h"
 #include "utils/Slice.h"
 #include "utils/Status.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <future>
+#include <iostream>
+#include <list>
+#include <thread>
+#include <unordered_map>
 namespace rangedb {
 
-LsmTable::LsmTable(RingHashVec *mem_vector) {  
+LsmTable::LsmTable(RingHashVec *mem_vector, const LsmTableOptions &options)
+    : options_(options), stage_queue_(2 * std::max<size_t>(options.flush_thread_num_, 1)) {
     mem_vector_ = mem_vector;
-    db_file_id_ = 0;
-    mutable_mem_block_ = new WalBlockFile(db_file_id_.fetch_add(1));
+    mem_usage_ = 0;
+    // the ids go on after the files of the manifest, the wal block files are recovered later;
+    // the file of the mutable memtable is only created with its first record, so recovery
+    // never takes it for a file left before the restart
+    std::vector<FileInfo> file_infos;
+    ManifestPtr manifest = Manifest::ManifestGetInstance();
+    manifest->ReadFileRecode(&file_infos);
+    uint64_t next_file_id = manifest->next_file_id_;
+    for (auto &file_info : file_infos) {
+        next_file_id = std::max(next_file_id, file_info.file_id_ + 1);
+    }
+    db_file_id_ = next_file_id;
+    batch_seq_ = manifest->batch_seq_;
+    for (size_t i = 0; i < std::max<size_t>(options_.stream_num_, 1); i++) {
+        auto stream = std::make_unique<MemStream>();
+        stream->mem_file_ = NewMemFile();
+        stream->mem_file_id_ = stream->mem_file_->GetFileId();
+        streams_.push_back(std::move(stream));
+    }
     file_manager_ = FileManager::GetInstance();
     BuildSstFile();
+    for (auto &stream : streams_) {
+        MemStream *sync_stream = stream.get();
+        stream->sync_thread_ = std::thread([this, sync_stream]() { RunSyncer(*sync_stream); });
+    }
+}
+
+LsmTable::~LsmTable() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        flush_stop_ = true;
+    }
+    flush_cv_.notify_all();
+    stall_cv_.notify_all();
+    for (auto &thread : build_threads_) {
+        thread.join();
+    }
+    // no flush is left to run a stage
+    stage_queue_.Close();
+    for (auto &thread : stage_threads_) {
+        thread.join();
+    }
+    StopSyncer();
+}
+
+uint64_t LsmTable::NewFileId() {
+    std::lock_guard<std::mutex> lock(manifest_mutex_);
+    uint64_t file_id = db_file_id_.fetch_add(1);
+    Manifest::ManifestGetInstance()->UpdateNextFileId(file_id + 1);
+    return file_id;
 }
 
-Status LsmTable::GetFromMemBlock(Slice *source) {  
-    if (source->file_id_ == mutable_mem_block_->GetFileId()) {
-        storage::BlockPtr block = mutable_mem_block_->ReadBlock(source->block_id_);
+WalBlockFilePtr LsmTable::NewMemFile() { return std::make_shared<WalBlockFile>(NewFileId()); }
+
+Status LsmTable::OpenMemFile(const WalBlockFilePtr &file) {
+    Status status = file->Open();
+    if (!status.ok()) {
+        std::cout << "open wal block file " << file->GetFileId() << " failed: " << status.ToString() << std::endl;
+        return status;
+    }
+    FileInfo file_info;
+    file_info.file_id_ = file->GetFileId();
+    file_info.level = 0;
+    std::lock_guard<std::mutex> lock(manifest_mutex_);
+    Manifest::ManifestGetInstance()->AppendFileRecode(&file_info);
+    return Status::OK();
+}
+
+Status LsmTable::EnsureMemFileOpen(MemStream &stream) {
+    if (stream.mem_file_->IsOpen()) {
+        return Status::OK();
+    }
+    // the first record of the memtable, a record is only taken once it can reach the file,
+    // whatever its durability
+    return OpenMemFile(stream.mem_file_);
+}
+
+Status LsmTable::GetFromMemBlock(Slice *source) {
+    // the stream of the key holds the memtable while it is mutable and seals it into the list
+    MemStream &stream = *streams_[GetStreamId(source->key_)];
+    std::lock_guard<std::mutex> stream_lock(stream.mutex_);
+    if (source->file_id_ == stream.mem_file_->GetFileId()) {
+        storage::BlockPtr block = stream.mem_file_->ReadBlock(source->block_id_);
         block->Read(source);
+        source->data_holder_ = block;
         return Status::OK();
     }
+    std::lock_guard<std::mutex> lock(mutex_);
     for (auto &mem_file : unmutabl_mem_file_list_) {
         if (source->file_id_ == mem_file->GetFileId()) {
             storage::BlockPtr block = mem_file->ReadBlock(source->block_id_);
             block->Read(source);
+            // the value points into the block, the memtable may be flushed and freed meanwhile
+            source->data_holder_ = block;
             return Status::OK();
         }
     }
@@ -35,55 +123,659 @@ Status LsmTable::GetFromMemBlock(Slice *source) {
 
 Status LsmTable::GetFromLevelFile(Slice *source, Task *task) {
     // l1 read
-    Status status;
-    file_manager_->BinaryRangeSearch(source->key_, task->level_);
-    return status;
+    storage::BlockFilePtr block_file = file_manager_->BinaryRangeSearch(source->key_, task->level_);
+    auto sst_file = std::dynamic_pointer_cast<storage::SstBlockFile>(block_file);
+    if (sst_file == nullptr) {
+        return Status(DB_NOT_FOUND, "key not found");
+    }
+    return sst_file->Get(source);
+}
+
+Status LsmTable::Seal(MemStream &stream) {
+    // the records of the sealed memtable are synced before the next file takes lsns
+    Status status = stream.mem_file_->Flush();
+    if (!status.ok()) {
+        return status;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        immutable_num_++;
+        immutable_bytes_ += stream.mem_file_->GetBlockNum() * storage::BLOCK_SIZE;
+        unmutabl_mem_file_list_.emplace_back(stream.mem_file_);
+        flush_queue_.emplace_back(stream.mem_file_);
+    }
+    stream.mem_file_ = NewMemFile();
+    stream.mem_file_id_ = stream.mem_file_->GetFileId();
+    flush_cv_.notify_one();
+    return Status::OK();
+}
+
+void LsmTable::RequestFlush() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!unmutabl_mem_file_list_.empty()) {
+            return;
+        }
+    }
+    // the keys are spread over the streams, their memtables fill alike and are sealed together
+    for (auto &stream : streams_) {
+        std::lock_guard<std::mutex> lock(stream->mutex_);
+        if (stream->mem_file_->GetBlockNum() > 0) {
+            Status status = Seal(*stream);
+            if (!status.ok()) {
+                std::cout << "seal memtable failed: " << status.ToString() << std::endl;
+            }
+        }
+    }
+}
+
+void LsmTable::Throttle() {
+    if (!IsSlowdownLimit()) {
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    if (IsStopLimit()) {
+        stop_num_++;
+        std::unique_lock<std::mutex> lock(mutex_);
+        stall_cv_.wait(lock, [this]() { return !IsStopLimit() || flush_stop_; });
+    } else {
+        // spread the delay over the writers so the flushes catch up before the stop limit
+        slowdown_num_++;
+        std::this_thread::sleep_for(std::chrono::microseconds(options_.slowdown_delay_us_));
+    }
+    stall_micros_ += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+Status LsmTable::Put(Slice *source, storage::MXLogDurability durability, uint64_t *lsn) {
+    Throttle();
+    MemStream &stream = *streams_[GetStreamId(source->key_)];
+    uint64_t record_lsn = 0;
+    {
+        std::lock_guard<std::mutex> lock(stream.mutex_);
+        if (stream.mem_file_->remind() < storage::RecordSize(*source)) {
+            Status status = Seal(stream);
+            if (!status.ok()) {
+                return status;
+            }
+        }
+        Status status = EnsureMemFileOpen(stream);
+        if (!status.ok()) {
+            return status;
+        }
+        int block_num = stream.mem_file_->GetBlockNum();
+        stream.mem_file_->Append(source);
+        mem_usage_ += (stream.mem_file_->GetBlockNum() - block_num) * storage::BLOCK_SIZE;
+        if (durability != storage::MXLogDurability::Buffered) {
+            status = stream.mem_file_->Write();
+            if (!status.ok()) {
+                return status;
+            }
+        }
+        // indexed before the lock goes, so puts of a key are indexed in log order and a seal
+        // and flush of the memtable find the record in the index; only the ack waits for a sync
+        mem_vector_->insert(source);
+        record_lsn = GetLsn(stream.mem_file_);
+    }
+    if (lsn != nullptr) {
+        *lsn = record_lsn;
+    }
+    if (durability == storage::MXLogDurability::Synced && !WaitForSync(record_lsn)) {
+        return Status(DB_ERROR, "sync wal block file failed");
+    }
+    return Status::OK();
+}
+
+Status LsmTable::Write(WriteBatch *batch, storage::MXLogDurability durability, uint64_t *lsn) {
+    if (batch->Count() == 0) {
+        return Status::OK();
+    }
+    // every block the batch spans may leave less than one record unused
+    size_t batch_size = batch->ByteSize() + (batch->ByteSize() / storage::BLOCK_SIZE + 1) * batch->MaxRecordSize();
+    if (batch_size > storage::MAX_BLOCK_NUM * storage::BLOCK_SIZE) {
+        return Status(DB_ERROR, "write batch is larger than a memtable");
+    }
+    Throttle();
+    size_t stream_id = GetStreamId(batch->GetSlices()[0].key_);
+    for (auto &slice : batch->GetSlices()) {
+        if (GetStreamId(slice.key_) != stream_id) {
+            return WriteAcrossStreams(batch, lsn);
+        }
+    }
+    MemStream &stream = *streams_[stream_id];
+    uint64_t record_lsn = 0;
+    {
+        std::lock_guard<std::mutex> lock(stream.mutex_);
+        if (stream.mem_file_->remind() < batch_size) {
+            Status status = Seal(stream);
+            if (!status.ok()) {
+                return status;
+            }
+        }
+        Status status = EnsureMemFileOpen(stream);
+        if (!status.ok()) {
+            return status;
+        }
+        int block_num = stream.mem_file_->GetBlockNum();
+        uint64_t first_lsn = GetLsn(stream.mem_file_);
+        stream.mem_file_->AppendBatch(batch->GetSlices());
+        mem_usage_ += (stream.mem_file_->GetBlockNum() - block_num) * storage::BLOCK_SIZE;
+        batch->SetLsnRange(first_lsn, GetLsn(stream.mem_file_));
+        if (durability != storage::MXLogDurability::Buffered) {
+            status = stream.mem_file_->Write();
+            if (!status.ok()) {
+                return status;
+            }
+        }
+        // all of the batch at once, as Put does for one record
+        mem_vector_->insert(batch->GetSlices());
+        record_lsn = GetLsn(stream.mem_file_);
+    }
+    if (lsn != nullptr) {
+        *lsn = record_lsn;
+    }
+    if (durability == storage::MXLogDurability::Synced && !WaitForSync(record_lsn)) {
+        return Status(DB_ERROR, "sync wal block file failed");
+    }
+    return Status::OK();
 }
 
-Status LsmTable::Put(Slice *source) {
-    if (mutable_mem_block_->remind() < source->Size()) {
-        unmutabl_mem_file_list_.emplace_back(mutable_mem_block_);
-        mutable_mem_block_ = new WalBlockFile(db_file_id_.fetch_add(1));
+Status LsmTable::WriteAcrossStreams(WriteBatch *batch, uint64_t *lsn) {
+    // the records of every stream in put order, the map orders the streams for the locks
+    std::vector<Slice> &slices = batch->GetSlices();
+    std::map<size_t, std::vector<size_t>> parts;
+    for (size_t i = 0; i < slices.size(); i++) {
+        parts[GetStreamId(slices[i].key_)].push_back(i);
+    }
+    std::lock_guard<std::mutex> batch_lock(batch_mutex_);
+    std::vector<std::unique_lock<std::mutex>> locks;
+    for (auto &part : parts) {
+        locks.emplace_back(streams_[part.first]->mutex_);
+    }
+    // every memtable takes its part before any part is appended, a part is never left behind
+    // by a batch that failed
+    for (auto &part : parts) {
+        MemStream &stream = *streams_[part.first];
+        size_t part_size = 0;
+        for (size_t i : part.second) {
+            part_size += storage::RecordSize(slices[i]);
+        }
+        part_size += (part_size / storage::BLOCK_SIZE + 1) * batch->MaxRecordSize();
+        if (stream.mem_file_->remind() < part_size) {
+            Status status = Seal(stream);
+            if (!status.ok()) {
+                return status;
+            }
+        }
+        Status status = EnsureMemFileOpen(stream);
+        if (!status.ok()) {
+            return status;
+        }
+    }
+    // a failed batch keeps its sequence, the next one takes a new one
+    uint64_t seq = ++batch_seq_;
+    uint64_t first_lsn = 0;
+    uint64_t record_lsn = 0;
+    for (auto &part : parts) {
+        MemStream &stream = *streams_[part.first];
+        std::vector<Slice> part_slices;
+        for (size_t i : part.second) {
+            part_slices.push_back(slices[i]);
+        }
+        int block_num = stream.mem_file_->GetBlockNum();
+        if (first_lsn == 0) {
+            first_lsn = GetLsn(stream.mem_file_);
+        }
+        stream.mem_file_->AppendBatch(part_slices, seq);
+        mem_usage_ += (stream.mem_file_->GetBlockNum() - block_num) * storage::BLOCK_SIZE;
+        for (size_t j = 0; j < part.second.size(); j++) {
+            slices[part.second[j]] = part_slices[j];
+        }
+        record_lsn = GetLsn(stream.mem_file_);
+    }
+    batch->SetLsnRange(first_lsn, record_lsn);
+    // every part is synced before the commit, recovery keeps the parts of the committed batches
+    for (auto &part : parts) {
+        MemStream &stream = *streams_[part.first];
+        Status status = stream.mem_file_->Flush();
+        if (!status.ok()) {
+            return status;
+        }
+        uint64_t synced_lsn = GetLsn(stream.mem_file_);
+        std::lock_guard<std::mutex> sync_lock(stream.sync_mutex_);
+        if (synced_lsn > stream.synced_lsn_) {
+            stream.synced_lsn_ = synced_lsn;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(manifest_mutex_);
+        ManifestPtr manifest = Manifest::ManifestGetInstance();
+        manifest->UpdateBatchSeq(seq);
+        manifest->Sync();
+    }
+    mem_vector_->insert(slices);
+    if (lsn != nullptr) {
+        *lsn = record_lsn;
     }
-    mutable_mem_block_->Append(source);
-    source->file_id_ = mutable_mem_block_->GetFileId();
     return Status::OK();
 }
 
+uint64_t LsmTable::Recover(std::vector<WalBlockFilePtr> files) {
+    std::sort(files.begin(), files.end(), [](const WalBlockFilePtr &a, const WalBlockFilePtr &b) { return a->GetFileId() < b->GetFileId(); });
+    std::lock_guard<std::mutex> batch_lock(batch_mutex_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t committed_seq = Manifest::ManifestGetInstance()->batch_seq_;
+    std::vector<WalBlockFilePtr> replayed;
+    for (auto &file : files) {
+        // the writer of a batch spanning streams held the locks of its memtables until the
+        // batch was committed, a part of one that was not is the last batch of its file
+        uint64_t seq = file->GetLastSeq();
+        batch_seq_ = std::max(batch_seq_, seq);
+        if (seq > committed_seq) {
+            std::cout << "wal block file " << file->GetFileId() << " ends in a part of write batch " << seq
+                      << " not committed, dropped" << std::endl;
+            Status status = file->DropLastBatch();
+            if (!status.ok()) {
+                std::cout << "drop write batch " << seq << " from wal block file " << file->GetFileId() << " failed: " << status.ToString()
+                          << std::endl;
+            }
+        }
+        if (file->GetRecordNum() == 0) {
+            // created or torn before its first record reached it, nothing to flush
+            DropMemFile(file);
+            continue;
+        }
+        replayed.push_back(file);
+    }
+    uint64_t record_num = ReplayMemFiles(replayed);
+    for (auto &file : replayed) {
+        mem_usage_ += file->GetBlockNum() * storage::BLOCK_SIZE;
+        immutable_num_++;
+        immutable_bytes_ += file->GetBlockNum() * storage::BLOCK_SIZE;
+        unmutabl_mem_file_list_.emplace_back(file);
+        flush_queue_.emplace_back(file);
+    }
+    flush_cv_.notify_all();
+    return record_num;
+}
+
+bool LsmTable::WaitForSync(uint64_t lsn) {
+    std::promise<bool> synced;
+    std::future<bool> result = synced.get_future();
+    AsyncWaitForSync(lsn, [&synced](bool ok) { synced.set_value(ok); });
+    return result.get();
+}
+
+void LsmTable::AsyncWaitForSync(uint64_t lsn, std::function<void(bool)> done) {
+    // the lsns of a stream grow with its file ids, a file no stream appends to anymore was
+    // synced when it was sealed
+    MemStream *stream = nullptr;
+    for (auto &candidate : streams_) {
+        if (candidate->mem_file_id_.load() == lsn >> 32) {
+            stream = candidate.get();
+            break;
+        }
+    }
+    if (stream == nullptr) {
+        done(true);
+        return;
+    }
+    std::unique_lock<std::mutex> lock(stream->sync_mutex_);
+    if (stream->synced_lsn_ >= lsn || stream->sync_stop_) {
+        bool synced = stream->synced_lsn_ >= lsn;
+        lock.unlock();
+        done(synced);
+        return;
+    }
+    stream->sync_waiters_.emplace(lsn, std::move(done));
+    stream->sync_requested_ = true;
+    stream->sync_cv_.notify_all();
+}
+
+void LsmTable::RunSyncer(MemStream &stream) {
+    std::unique_lock<std::mutex> lock(stream.sync_mutex_);
+    while (true) {
+        stream.sync_cv_.wait_for(lock, std::chrono::milliseconds(storage::MXLOG_SYNC_INTERVAL_MS),
+                                 [&stream]() { return stream.sync_stop_ || stream.sync_requested_; });
+        bool stop = stream.sync_stop_;
+        stream.sync_requested_ = false;
+        lock.unlock();
+
+        // one fdatasync covers every record appended before the write, the sealed memtables
+        // were synced when they were sealed; a flush deleting the file waits for the sync
+        WalBlockFilePtr file;
+        uint64_t lsn = 0;
+        Status status;
+        {
+            std::lock_guard<std::mutex> stream_lock(stream.mutex_);
+            file = stream.mem_file_;
+            status = file->Write();
+            lsn = GetLsn(file);
+        }
+        if (status.ok()) {
+            status = file->Sync();
+        }
+
+        lock.lock();
+        if (status.ok()) {
+            if (lsn > stream.synced_lsn_) {
+                stream.synced_lsn_ = lsn;
+            }
+        } else {
+            sync_error_num_++;
+            std::cout << "sync wal block file " << file->GetFileId() << " failed: " << status.ToString() << ", synced lsn "
+                      << stream.synced_lsn_ << std::endl;
+        }
+        // a failed sync fails the waiters it covered only, the later records get their own
+        std::vector<std::pair<bool, std::function<void(bool)>>> done;
+        auto &waiters = stream.sync_waiters_;
+        auto end = stop ? waiters.end() : waiters.upper_bound(std::max<uint64_t>(lsn, stream.synced_lsn_));
+        for (auto it = waiters.begin(); it != end; it = waiters.erase(it)) {
+            done.emplace_back(it->first <= stream.synced_lsn_, std::move(it->second));
+        }
+        // the records of the waiters left were appended after the write
+        stream.sync_requested_ = !waiters.empty();
+        lock.unlock();
+        for (auto &waiter : done) {
+            waiter.second(waiter.first);
+        }
+        if (stop) {
+            break;
+        }
+        lock.lock();
+    }
+}
+
+void LsmTable::StopSyncer() {
+    for (auto &stream : streams_) {
+        {
+            std::lock_guard<std::mutex> lock(stream->sync_mutex_);
+            if (stream->sync_stop_) {
+                continue;
+            }
+            stream->sync_stop_ = true;
+        }
+        stream->sync_cv_.notify_all();
+        // the syncer syncs the buffered records once more before it exits
+        stream->sync_thread_.join();
+    }
+}
+
+std::future<void> LsmTable::RunStage(std::function<void()> stage) {
+    auto task = std::make_shared<std::packaged_task<void()>>(std::move(stage));
+    std::future<void> done = task->get_future();
+    stage_queue_.Push([task]() { (*task)(); });
+    return done;
+}
+
 void LsmTable::BuildSstFile() {
-    build_thread_ = std::thread([this]() {
-        while (true) {
-            std::this_thread::sleep_for(std::chrono::seconds(1));
-            while (unmutabl_mem_file_list_.size() > 100) {
-                auto front = unmutabl_mem_file_list_.front();
-                uint64_t file_id = db_file_id_.fetch_add(1);
-                storage::SstBlockFilePtr new_sst_file = std::make_shared<storage::SstBlockFile>(file_id);
-                file_manager_->AddBlockFile(file_id, new_sst_file);
-                Iterator *iter = front->NewIterator(ByteKeyComparator());
-                iter->SeekToFirst();
-                while (!iter->End()) {
-                    Slice value = iter->Value();
-                    value.file_id_ = file_id;
-                    new_sst_file->Append(&value);
-                    mem_vector_->insert(&value);
-                    iter->Next();
+    // every flush runs two stages at once, a stage never waits for a thread
+    for (size_t i = 0; i < 2 * std::max<size_t>(options_.flush_thread_num_, 1); i++) {
+        stage_threads_.emplace_back([this]() {
+            std::function<void()> stage;
+            while (stage_queue_.Pop(stage)) {
+                stage();
+            }
+        });
+    }
+    for (size_t i = 0; i < std::max<size_t>(options_.flush_thread_num_, 1); i++) {
+        build_threads_.emplace_back([this]() {
+            uint64_t retry_delay_ms = FLUSH_RETRY_DELAY_MS;
+            while (true) {
+                // a memtable is flushed as soon as it is sealed
+                WalBlockFilePtr mem_file;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    flush_cv_.wait(lock, [this]() { return flush_stop_ || !flush_queue_.empty(); });
+                    if (flush_stop_) {
+                        break;
+                    }
+                    mem_file = flush_queue_.front();
+                    flush_queue_.pop_front();
+                }
+                Status status = FlushMemFile(mem_file);
+                if (!status.ok()) {
+                    // the memtable stays readable and counted against the write limits, it is
+                    // flushed again first after the backoff
+                    flush_error_num_++;
+                    std::cout << "flush memtable " << mem_file->GetFileId() << " failed: " << status.ToString() << ", retry in "
+                              << retry_delay_ms << "ms" << std::endl;
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    flush_cv_.wait_for(lock, std::chrono::milliseconds(retry_delay_ms), [this]() { return flush_stop_; });
+                    retry_delay_ms = std::min(retry_delay_ms * 2, FLUSH_MAX_RETRY_DELAY_MS);
+                    flush_queue_.emplace_front(mem_file);
+                    continue;
                 }
-                iter->Value().Print();
-                Iterator *sst_iter = new_sst_file->NewIterator(ByteKeyComparator());
-                sst_iter->SeekToFirst();
-                const ByteKey &min_key = sst_iter->Key();
-                sst_iter->SeekToLast();
-                const ByteKey &max_key = sst_iter->Key();
-                FileInfo *file_info = new FileInfo();
-                file_info->file_id_ = file_id;
-                file_info->block_num_ = new_sst_file->GetBlockNum();
-                file_info->max_key_ = max_key;
-                file_info->min_key_ = min_key;
-                file_manager_->AddFileInfo(file_id, 1, file_info);
-                unmutabl_mem_file_list_.pop_front();
-                new_sst_file->Flush();
+                retry_delay_ms = FLUSH_RETRY_DELAY_MS;
+                // the index and the manifest point to the sst file now, the memtable and its
+                // wal block file can go
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    unmutabl_mem_file_list_.remove(mem_file);
+                    immutable_num_--;
+                    immutable_bytes_ -= mem_file->GetBlockNum() * storage::BLOCK_SIZE;
+                }
+                stall_cv_.notify_all();
+                mem_usage_ -= mem_file->GetBlockNum() * storage::BLOCK_SIZE;
+                file_manager_->RemoveBlockFile(mem_file->GetFileId());
+                mem_file->DeleteFile();
+            }
+        });
+    }
+}
+
+void LsmTable::DeleteMemFileRecode(uint64_t mem_file_id) {
+    std::lock_guard<std::mutex> lock(manifest_mutex_);
+    ManifestPtr manifest = Manifest::ManifestGetInstance();
+    manifest->DeleteFileRecode(mem_file_id);
+    manifest->Sync();
+}
+
+void LsmTable::DropMemFile(const WalBlockFilePtr &mem_file) {
+    DeleteMemFileRecode(mem_file->GetFileId());
+    file_manager_->RemoveBlockFile(mem_file->GetFileId());
+    mem_file->DeleteFile();
+}
+
+Status LsmTable::FlushMemFile(const WalBlockFilePtr &mem_file) {
+    if (mem_file->GetRecordNum() == 0) {
+        // no sst file for a memtable without records, its wal block file just goes
+        DeleteMemFileRecode(mem_file->GetFileId());
+        return Status::OK();
+    }
+    uint64_t file_id = NewFileId();
+    storage::SstBlockFilePtr new_sst_file = std::make_shared<storage::SstBlockFile>(file_id);
+    file_manager_->AddBlockFile(file_id, new_sst_file);
+
+    // iterate stage: cut the records of the memtable in key order into batches
+    BoundedQueue<std::vector<Slice>> encode_queue(FLUSH_QUEUE_DEPTH);
+    std::future<void> iterate_done = RunStage([&mem_file, &encode_queue]() {
+        // a linear walk of the records merged in key order
+        mem_file->SortRecords();
+        Iterator *iter = mem_file->NewIterator(ByteKeyComparator());
+        iter->SeekToFirst();
+        std::vector<Slice> batch;
+        while (!iter->End()) {
+            batch.push_back(iter->Value());
+            if (batch.size() == FLUSH_BATCH_SIZE) {
+                encode_queue.Push(std::move(batch));
+                batch.clear();
+            }
+            iter->Next();
+        }
+        if (!batch.empty()) {
+            encode_queue.Push(std::move(batch));
+        }
+        delete iter;
+        encode_queue.Close();
+    });
+
+    // write stage: write the full blocks, the index is pointed to their records once the
+    // whole file is synced
+    struct FlushWrite {
+        size_t first_block_id_;
+        std::vector<storage::BlockPtr> blocks_;
+        std::vector<FlushRecord> records_;
+    };
+    BoundedQueue<FlushWrite> write_queue(FLUSH_QUEUE_DEPTH);
+    Status write_status;
+    std::vector<FlushRecord> written;
+    std::future<void> write_done = RunStage([&new_sst_file, &write_queue, &write_status, &written]() {
+        FlushWrite write;
+        while (write_queue.Pop(write)) {
+            if (write_status.ok()) {
+                write_status = new_sst_file->WriteBlocks(write.first_block_id_, write.blocks_);
+            }
+            if (write_status.ok()) {
+                written.insert(written.end(), std::make_move_iterator(write.records_.begin()),
+                               std::make_move_iterator(write.records_.end()));
             }
         }
     });
+
+    // encode stage: append the records to the sst blocks on this thread
+    std::vector<FlushRecord> pending;
+    size_t taken_block_num = 0;
+    std::vector<Slice> batch;
+    while (encode_queue.Pop(batch)) {
+        for (auto &value : batch) {
+            FlushRecord record{value.block_id_, value.offset_, value};
+            record.slice_.file_id_ = file_id;
+            new_sst_file->Append(&record.slice_);
+            pending.push_back(record);
+        }
+        std::vector<storage::BlockPtr> blocks = new_sst_file->TakeFullBlocks();
+        if (blocks.empty()) {
+            continue;
+        }
+        FlushWrite write{taken_block_num, std::move(blocks), {}};
+        taken_block_num += write.blocks_.size();
+        // the records appended in order, the ones of the full blocks come first
+        auto end = std::find_if(pending.begin(), pending.end(),
+                                [taken_block_num](const FlushRecord &record) { return record.slice_.block_id_ >= taken_block_num; });
+        write.records_.assign(std::make_move_iterator(pending.begin()), std::make_move_iterator(end));
+        pending.erase(pending.begin(), end);
+        write_queue.Push(std::move(write));
+    }
+    iterate_done.wait();
+    write_queue.Close();
+    write_done.wait();
+    // the header and the last block, then one sync for the whole file
+    Status status = write_status.ok() ? new_sst_file->Flush() : write_status;
+    if (!status.ok()) {
+        // nothing points to the file yet, it goes before the memtable is flushed again
+        file_manager_->RemoveBlockFile(file_id);
+        new_sst_file->GetFileHandle()->DeleteFile();
+        return status;
+    }
+    UpdateIndex(mem_file->GetFileId(), written);
+    UpdateIndex(mem_file->GetFileId(), pending);
+
+    // the records were appended in key order, the first and the last bound the file
+    FileInfo *file_info = new FileInfo();
+    file_info->file_id_ = file_id;
+    file_info->block_num_ = new_sst_file->GetBlockNum();
+    file_info->min_key_ = (written.empty() ? pending.front() : written.front()).slice_.key_;
+    file_info->max_key_ = (pending.empty() ? written.back() : pending.back()).slice_.key_;
+    file_info->type = 1;
+    file_info->level = 1;
+    file_info->mem_file_id_ = mem_file->GetFileId();
+    file_manager_->AddFileInfo(file_id, 1, file_info);
+    // a restart loads the sst file instead of the wal block file from now on
+    {
+        std::lock_guard<std::mutex> lock(manifest_mutex_);
+        ManifestPtr manifest = Manifest::ManifestGetInstance();
+        manifest->AppendFileRecode(file_info);
+        manifest->DeleteFileRecode(mem_file->GetFileId());
+        manifest->Sync();
+    }
+    return Status::OK();
+}
+
+uint64_t LsmTable::ReplayMemFiles(const std::vector<WalBlockFilePtr> &files) {
+    size_t partition_num = std::max<size_t>(options_.recover_thread_num_, 1);
+    auto run_parallel = [partition_num](const std::function<void(size_t)> &work) {
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < partition_num; i++) {
+            threads.emplace_back(work, i);
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+    };
+    // the flushes finish out of order, an sst file of a newer memtable may be in the index
+    // already while an older memtable is replayed
+    std::unordered_map<uint64_t, uint64_t> sst_mem_file_ids;
+    uint64_t max_sst_mem_file_id = 0;
+    std::list<FileInfo *> file_infos;
+    file_manager_->GetLevelFile(1, &file_infos);
+    for (auto &file_info : file_infos) {
+        sst_mem_file_ids[file_info->file_id_] = file_info->mem_file_id_;
+        max_sst_mem_file_id = std::max(max_sst_mem_file_id, file_info->mem_file_id_);
+    }
+
+    // decode stage: the offsets of the records of every block, split by partition
+    struct ReplayBlock {
+        WalBlockFilePtr file_;
+        uint32_t block_id_;
+        std::vector<std::vector<uint32_t>> offsets_;
+    };
+    std::vector<ReplayBlock> blocks;
+    for (auto &file : files) {
+        for (int i = 0; i < file->GetBlockNum(); i++) {
+            blocks.push_back(ReplayBlock{file, (uint32_t)i, std::vector<std::vector<uint32_t>>(partition_num)});
+        }
+    }
+    std::atomic<size_t> next_block{0};
+    run_parallel([&](size_t) {
+        for (size_t i = next_block++; i < blocks.size(); i = next_block++) {
+            ReplayBlock &block = blocks[i];
+            block.file_->ForEachRecord(block.block_id_, [&](Slice *slice) {
+                block.offsets_[mem_vector_->GetRingIndex(slice->key_.hash_0_) % partition_num].push_back(slice->offset_);
+            });
+        }
+    });
+
+    // apply stage: every key is in one partition, its applier walks the blocks in log order so
+    // the later records of the key replace the earlier ones
+    std::atomic<uint64_t> record_num{0};
+    run_parallel([&](size_t partition) {
+        uint64_t applied = 0;
+        for (auto &block : blocks) {
+            storage::BlockPtr data = block.file_->ReadBlock(block.block_id_);
+            bool check_sst = block.file_->GetFileId() < max_sst_mem_file_id;
+            for (uint32_t offset : block.offsets_[partition]) {
+                Slice slice;
+                slice.offset_ = offset;
+                data->Read(&slice);
+                if (check_sst) {
+                    Slice current;
+                    current.key_ = slice.key_;
+                    if (mem_vector_->find(&current) && current.block_type_ == 1) {
+                        auto it = sst_mem_file_ids.find(current.file_id_);
+                        if (it != sst_mem_file_ids.end() && it->second > block.file_->GetFileId()) {
+                            continue;
+                        }
+                    }
+                }
+                mem_vector_->insert(&slice);
+                applied++;
+            }
+        }
+        record_num += applied;
+    });
+    return record_num;
+}
+
+void LsmTable::UpdateIndex(uint64_t mem_file_id, const std::vector<FlushRecord> &records) {
+    Slice expected;
+    expected.block_type_ = 0;
+    expected.file_id_ = mem_file_id;
+    for (auto &record : records) {
+        // a put of the key since the memtable was sealed keeps its newer entry
+        expected.block_id_ = record.mem_block_id_;
+        expected.offset_ = record.mem_offset_;
+        Slice slice = record.slice_;
+        mem_vector_->TryInsert(&expected, &slice);
+    }
 }
 } // namespace rangedb
\ No newline at end of file
@@ -1,29 +1,255 @@
 #pragma once
 
+#include "db/WriteBatch.h"
 #include "db/index/RingHashVec.h"
 #include "storage/FileManager.h"
+#include "storage/wal/WalDefinations.h"
 #include "storage/walblock/WalBlock.h"
 #include "storage/walblock/WalBlockFile.h"
+#include "utils/BoundedQueue.h"
 #include "utils/Slice.h"
 #include "utils/Status.h"
 #include "utils/Task.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
 namespace rangedb {
+// writes are delayed by MEMTABLE_SLOWDOWN_DELAY_US once the immutable memtables waiting for a
+// flush reach the slowdown limits, and stop until a flush finished at the stop limits
+const size_t MEMTABLE_SLOWDOWN_NUM = 4;
+const size_t MEMTABLE_STOP_NUM = 8;
+const size_t MEMTABLE_SLOWDOWN_BYTES = 512ULL * 1024 * 1024;
+const size_t MEMTABLE_STOP_BYTES = 1024ULL * 1024 * 1024;
+const uint64_t MEMTABLE_SLOWDOWN_DELAY_US = 1000;
+// immutable memtables flushed at once, each flush is a pipeline of an iterate, an encode and
+// a write stage connected by queues of FLUSH_QUEUE_DEPTH items; the encode stage runs on the
+// flush thread, the other two on stage threads started with the flush threads
+const size_t FLUSH_THREAD_NUM = 2;
+const size_t FLUSH_QUEUE_DEPTH = 4;
+// records handed from the iterate to the encode stage at once
+const size_t FLUSH_BATCH_SIZE = 1024;
+// a failed flush is retried after FLUSH_RETRY_DELAY_MS, doubled on every failure in a row up
+// to FLUSH_MAX_RETRY_DELAY_MS
+const uint64_t FLUSH_RETRY_DELAY_MS = 100;
+const uint64_t FLUSH_MAX_RETRY_DELAY_MS = 10000;
+// threads that decode the recovered memtables and apply their records to the index, the
+// records of a key always go to the same applier
+const size_t RECOVER_THREAD_NUM = 8;
+// writers append to MEMTABLE_STREAM_NUM mutable memtables at once, each with its own lock, wal
+// block file and syncer; the records of a key always go to the stream of its ring partition
+const size_t MEMTABLE_STREAM_NUM = 4;
+
+struct LsmTableOptions {
+    size_t slowdown_num_ = MEMTABLE_SLOWDOWN_NUM;
+    size_t stop_num_ = MEMTABLE_STOP_NUM;
+    size_t slowdown_bytes_ = MEMTABLE_SLOWDOWN_BYTES;
+    size_t stop_bytes_ = MEMTABLE_STOP_BYTES;
+    uint64_t slowdown_delay_us_ = MEMTABLE_SLOWDOWN_DELAY_US;
+    size_t flush_thread_num_ = FLUSH_THREAD_NUM;
+    size_t recover_thread_num_ = RECOVER_THREAD_NUM;
+    size_t stream_num_ = MEMTABLE_STREAM_NUM;
+};
+
+// The memtables are wal block files, a Put is written once to the block of the mutable
+// memtable and that block is its write ahead log record.
+//
+// The writes are split into streams by key, each stream has its own mutable memtable, lock and
+// syncer, so writers of different keys do not wait for each other. The records of a key are
+// always in the memtables of one stream, which are sealed in file id order, so the file ids
+// order them on recovery as they do with one stream.
+//
+// Durable writes are group committed per stream: writers only copy their records into the
+// block under the lock of the stream and take the lsn of their end, the syncer of the stream
+// writes everything appended since its last write with one write and one fdatasync, and every
+// writer waiting for an lsn up to the end of that write is acknowledged by it. The fdatasyncs
+// are bounded by the syncers, not by the writers, so durable throughput grows with the number
+// of writers.
 class LsmTable {
 
 public:
-    LsmTable(RingHashVec *mem_vector_);
-    ~LsmTable(){};
+    LsmTable(RingHashVec *mem_vector_, const LsmTableOptions &options = LsmTableOptions());
+    ~LsmTable();
     Status GetFromMemBlock(Slice *source);
-    Status Put(Slice *source);
+
+    // Append source to the mutable memtable and index it, delayed or stopped first while the
+    // flushes fall behind, see LsmTableOptions. A buffered record reaches the file with the next
+    // sync, a written one before Put returns and a synced one waits for the syncer. lsn is the
+    // position to wait for with WaitForSync.
+    Status Put(Slice *source, storage::MXLogDurability durability = storage::MXLogDurability::Buffered, uint64_t *lsn = nullptr);
+
+    // Append the records of batch back to back to one memtable, as Put does for one record: one
+    // lock, one write of the file and one lsn range cover all of them, recovery keeps all of them
+    // or none. The slices of batch get their positions and are indexed at once.
+    //
+    // A batch with keys of several streams is appended in parts to the memtables of its streams
+    // under all their locks with the next batch sequence, the parts are synced whatever the
+    // durability and the batch is committed by writing its sequence to the manifest; recovery
+    // drops the parts of a batch not committed. Its lsn range runs from the first to the last part.
+    Status Write(WriteBatch *batch, storage::MXLogDurability durability = storage::MXLogDurability::Buffered, uint64_t *lsn = nullptr);
+
+    // Block until the record at lsn is synced
+    bool WaitForSync(uint64_t lsn);
+
+    // Call done once the record at lsn is synced, from the syncer thread or inline if it
+    // already is, done gets false if the sync covering it failed or the table is stopped
+    void AsyncWaitForSync(uint64_t lsn, std::function<void(bool)> done);
+
+    // Take over the wal block files of the manifest as immutable memtables and index their
+    // records, returns the number of records indexed. Call after the level files are indexed:
+    // a record of a key an sst file flushed from a newer memtable holds is left out, and so are
+    // the parts of a write batch spanning streams that was not committed.
+    uint64_t Recover(std::vector<WalBlockFilePtr> files);
+
     Status GetFromLevelFile(Slice *source, Task *task);
+    // Start the flush threads, they take the memtables in the order they were sealed
     void BuildSstFile();
 
+    // Seal the mutable memtable so it is flushed, unless a flush is already queued
+    void RequestFlush();
+
+    // Bytes held by the blocks of the mutable and immutable memtables
+    size_t GetMemoryUsage() const { return mem_usage_.load(std::memory_order_relaxed); }
+
+    // Write stall metrics: Puts delayed, Puts stopped and the microseconds Puts spent in both
+    uint64_t GetSlowdownNum() const { return slowdown_num_.load(std::memory_order_relaxed); }
+    uint64_t GetStopNum() const { return stop_num_.load(std::memory_order_relaxed); }
+    uint64_t GetStallMicros() const { return stall_micros_.load(std::memory_order_relaxed); }
+    bool IsWriteStopped() const { return IsStopLimit(); }
+
+    // Flushes that failed and were queued again
+    uint64_t GetFlushErrorNum() const { return flush_error_num_.load(std::memory_order_relaxed); }
+
+    // Syncs of the mutable memtable that failed, the writers waiting for them got an error
+    uint64_t GetSyncErrorNum() const { return sync_error_num_.load(std::memory_order_relaxed); }
+
 private:
+    // a mutable memtable with its own lock and syncer, see LsmTableOptions::stream_num_
+    struct MemStream {
+        // guards mem_file_ and the appends to it
+        std::mutex mutex_;
+        WalBlockFilePtr mem_file_;
+        // the file id of mem_file_, read without mutex_ by the writers waiting for a sync
+        std::atomic<uint64_t> mem_file_id_{0};
+        std::thread sync_thread_;
+        std::mutex sync_mutex_;
+        std::condition_variable sync_cv_;
+        bool sync_stop_ = false;
+        bool sync_requested_ = false;
+        std::atomic<uint64_t> synced_lsn_{0};
+        std::multimap<uint64_t, std::function<void(bool)>> sync_waiters_;
+    };
+
+    size_t GetStreamId(const ByteKey &key) const { return mem_vector_->GetRingIndex(key.hash_0_) % streams_.size(); }
+
+    // Append the parts of a batch with keys of several streams, see Write
+    Status WriteAcrossStreams(WriteBatch *batch, uint64_t *lsn);
+
+    // a record of the memtable being flushed, slice_ is its copy in the sst file
+    struct FlushRecord {
+        uint32_t mem_block_id_;
+        uint64_t mem_offset_;
+        Slice slice_;
+    };
+
+    // Write mem_file to a new sst file and point the index to it
+    Status FlushMemFile(const WalBlockFilePtr &mem_file);
+
+    // Run a stage of a flush on a stage thread, there is one free for every stage of the
+    // flushes running
+    std::future<void> RunStage(std::function<void()> stage);
+
+    // Point the index to the sst copies of records it still finds in the memtable, a newer
+    // record of the key written or flushed meanwhile is left alone
+    void UpdateIndex(uint64_t mem_file_id, const std::vector<FlushRecord> &records);
+
+    // Index the records of files, sorted by file id, on recover_thread_num_ threads: the blocks
+    // are decoded in parallel and their records split by the ring partition of their key, then
+    // one applier per partition indexes its records in log order; returns the records indexed
+    uint64_t ReplayMemFiles(const std::vector<WalBlockFilePtr> &files);
+
+    // A file id never given before, also across restarts
+    uint64_t NewFileId();
+
+    // A new mutable memtable, its file is created and recorded in the manifest with its first
+    // record, see EnsureMemFileOpen
+    WalBlockFilePtr NewMemFile();
+
+    // Create the file of a memtable and record it in the manifest
+    Status OpenMemFile(const WalBlockFilePtr &file);
+
+    // Open the file of the mutable memtable of stream before its first record, or again once
+    // opening it failed, under the lock of stream; the memtable takes no records until it succeeds
+    Status EnsureMemFileOpen(MemStream &stream);
+
+    // Mark the manifest record of a memtable deleted and sync the manifest
+    void DeleteMemFileRecode(uint64_t mem_file_id);
+
+    // Remove a recovered memtable without records, its manifest record and its file
+    void DropMemFile(const WalBlockFilePtr &mem_file);
+
+    // Sync the mutable memtable of stream, queue it for the build thread and open a new one,
+    // under the lock of stream
+    Status Seal(MemStream &stream);
+
+    bool IsSlowdownLimit() const {
+        return immutable_num_.load(std::memory_order_relaxed) >= options_.slowdown_num_ ||
+               immutable_bytes_.load(std::memory_order_relaxed) >= options_.slowdown_bytes_;
+    }
+
+    bool IsStopLimit() const {
+        return immutable_num_.load(std::memory_order_relaxed) >= options_.stop_num_ ||
+               immutable_bytes_.load(std::memory_order_relaxed) >= options_.stop_bytes_;
+    }
+
+    // Delay or stop the writer while the immutable memtables are over the limits
+    void Throttle();
+
+    // lsn of the end of the records of file
+    static uint64_t GetLsn(const WalBlockFilePtr &file) { return file->GetFileId() << 32 | file->GetEndOffset(); }
+
+    // write and fdatasync the mutable memtable of stream every MXLOG_SYNC_INTERVAL_MS or once a
+    // waiter asks, and signal the waiters covered; a failed sync fails them and the syncer goes on
+    void RunSyncer(MemStream &stream);
+
+    void StopSyncer();
+
+    LsmTableOptions options_;
     std::atomic<uint64_t> db_file_id_;
-    WalBlockFile *mutable_mem_block_;
+    // guards the immutable memtables and the flush queue, taken after the lock of a stream
+    std::mutex mutex_;
+    // the build thread waits on flush_cv_ for a sealed memtable, stopped writers on stall_cv_
+    std::condition_variable flush_cv_;
+    std::condition_variable stall_cv_;
+    bool flush_stop_ = false;
+    std::atomic<size_t> immutable_num_{0};
+    std::atomic<size_t> immutable_bytes_{0};
+    std::atomic<uint64_t> slowdown_num_{0};
+    std::atomic<uint64_t> stop_num_{0};
+    std::atomic<uint64_t> stall_micros_{0};
+    std::atomic<uint64_t> flush_error_num_{0};
+    std::vector<std::unique_ptr<MemStream>> streams_;
+    // one write batch spanning streams at a time, taken before the locks of its streams; the
+    // sequence of the last one, committed or failed
+    std::mutex batch_mutex_;
+    uint64_t batch_seq_ = 0;
     RingHashVec *mem_vector_;
-    std::list<WalBlockFile*> unmutabl_mem_file_list_;
-    std::thread build_thread_;
+    std::list<WalBlockFilePtr> unmutabl_mem_file_list_;
+    std::vector<std::thread> build_threads_;
+    // the iterate and write stages of the flushes, two stage threads per flush thread
+    BoundedQueue<std::function<void()>> stage_queue_;
+    std::vector<std::thread> stage_threads_;
+    // sealed memtables no flush thread took yet, under mutex_
+    std::deque<WalBlockFilePtr> flush_queue_;
+    // guards the manifest updates of the writers and the flush threads
+    std::mutex manifest_mutex_;
     FileManager *file_manager_;
+    std::atomic<size_t> mem_usage_;
+
+    std::atomic<uint64_t> sync_error_num_{0};
 };
 } // namespace rangedb
\ No newline at end of file
@@ -0,0 +1,78 @@
+#pragma once
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace rangedb {
+// O_DIRECT needs the buffer, the file offset and the io size aligned to the logical block size
+const size_t DIRECT_IO_ALIGNMENT = 4096;
+
+inline size_t AlignUp(size_t size, size_t alignment = DIRECT_IO_ALIGNMENT) { return (size + alignment - 1) & ~(alignment - 1); }
+
+inline size_t AlignDown(size_t size, size_t alignment = DIRECT_IO_ALIGNMENT) { return size & ~(alignment - 1); }
+
+inline int8_t *AlignedAlloc(size_t size) {
+    void *buffer = nullptr;
+    if (posix_memalign(&buffer, DIRECT_IO_ALIGNMENT, AlignUp(size)) != 0) {
+        return nullptr;
+    }
+    return static_cast<int8_t *>(buffer);
+}
+
+inline void AlignedFree(int8_t *buffer) { free(buffer); }
+
+// AlignedBufferPool hands out fixed size buffers aligned to DIRECT_IO_ALIGNMENT.
+// Released buffers are kept on a free list, up to max_free of them, so the hot
+// read path does not pay for posix_memalign and free on every block.
+class AlignedBufferPool {
+public:
+    AlignedBufferPool(size_t buffer_size, size_t max_free) : buffer_size_(AlignUp(buffer_size)), max_free_(max_free) {}
+
+    ~AlignedBufferPool() {
+        for (auto buffer : free_list_) {
+            AlignedFree(buffer);
+        }
+    }
+
+    int8_t *Allocate() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!free_list_.empty()) {
+                int8_t *buffer = free_list_.back();
+                free_list_.pop_back();
+                return buffer;
+            }
+        }
+        return AlignedAlloc(buffer_size_);
+    }
+
+    void Release(int8_t *buffer) {
+        if (buffer == nullptr) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (free_list_.size() < max_free_) {
+                free_list_.push_back(buffer);
+                return;
+            }
+        }
+        AlignedFree(buffer);
+    }
+
+    size_t GetBufferSize() const { return buffer_size_; }
+
+    size_t GetFreeNum() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return free_list_.size();
+    }
+
+private:
+    size_t buffer_size_;
+    size_t max_free_;
+    std::mutex mutex_;
+    std::vector<int8_t *> free_list_;
+};
+} // namespace rangedb
@@ -0,0 +1,178 @@
+#pragma once
+#include "utils/NoDestructor.h"
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace rangedb {
+// threads reading under an epoch at the same time
+const size_t EPOCH_MAX_THREADS = 1024;
+// retired objects kept before a reclamation is tried
+const size_t EPOCH_RECLAIM_THRESHOLD = 64;
+
+// EpochManager implements epoch-based reclamation. A reader enters an epoch
+// before it looks up a shared object and exits once it no longer uses it, an
+// object removed from the shared structure is retired instead of released.
+// Retiring advances the global epoch and tags the object with the epoch it
+// was removed in, the object is released once every reader still inside an
+// epoch entered it after that tag. Entering and exiting only store to the
+// thread's own slot, readers of a hot object do not share a cache line.
+class EpochManager {
+public:
+    EpochManager() : global_epoch_(1) {}
+
+    ~EpochManager() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        retired_.clear();
+    }
+
+    EpochManager(const EpochManager &) = delete;
+    EpochManager &operator=(const EpochManager &) = delete;
+
+    // Enter the epoch of the calling thread, nested calls only count
+    void Enter() {
+        ThreadState &state = GetThreadState();
+        if (state.depth_++ > 0) {
+            return;
+        }
+        Slot &slot = slots_[state.slot_];
+        slot.epoch_.store(global_epoch_.load(std::memory_order_acquire), std::memory_order_relaxed);
+        // the slot has to be visible before the reader loads any shared pointer
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    void Exit() {
+        ThreadState &state = GetThreadState();
+        if (--state.depth_ > 0) {
+            return;
+        }
+        slots_[state.slot_].epoch_.store(0, std::memory_order_release);
+    }
+
+    // Release object once no reader can still see it, call after it is removed from the shared structure
+    void Retire(std::shared_ptr<void> object) {
+        uint64_t epoch = global_epoch_.fetch_add(1, std::memory_order_acq_rel);
+        bool reclaim = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            retired_.emplace_back(epoch, std::move(object));
+            reclaim = retired_.size() >= EPOCH_RECLAIM_THRESHOLD;
+        }
+        if (reclaim) {
+            Reclaim();
+        }
+    }
+
+    // Release the retired objects no reader can see, returns how many were released
+    size_t Reclaim() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint64_t min_epoch = std::numeric_limits<uint64_t>::max();
+        for (auto &slot : slots_) {
+            uint64_t epoch = slot.epoch_.load(std::memory_order_acquire);
+            if (epoch != 0 && epoch < min_epoch) {
+                min_epoch = epoch;
+            }
+        }
+        std::vector<std::shared_ptr<void>> released;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            size_t keep = 0;
+            for (auto &entry : retired_) {
+                if (entry.first < min_epoch) {
+                    released.emplace_back(std::move(entry.second));
+                } else {
+                    retired_[keep++] = std::move(entry);
+                }
+            }
+            retired_.resize(keep);
+        }
+        // the destructors run without the lock
+        return released.size();
+    }
+
+    size_t GetRetiredNum() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return retired_.size();
+    }
+
+    static EpochManager *GetInstance() {
+        static NoDestructor<EpochManager> instance;
+        return instance.get();
+    }
+
+private:
+    struct alignas(64) Slot {
+        // 0 when the thread is not inside an epoch
+        std::atomic<uint64_t> epoch_{0};
+        std::atomic<bool> used_{false};
+    };
+
+    // slot of the calling thread, given back when the thread exits
+    struct ThreadState {
+        EpochManager *manager_ = nullptr;
+        size_t slot_ = 0;
+        uint32_t depth_ = 0;
+
+        ~ThreadState() {
+            if (manager_ != nullptr) {
+                manager_->slots_[slot_].epoch_.store(0, std::memory_order_release);
+                manager_->slots_[slot_].used_.store(false, std::memory_order_release);
+            }
+        }
+    };
+
+    ThreadState &GetThreadState() {
+        thread_local ThreadState state;
+        if (state.manager_ != this) {
+            // a thread only reads under one manager, the process wide instance
+            state.slot_ = AcquireSlot();
+            state.manager_ = this;
+            state.depth_ = 0;
+        }
+        return state;
+    }
+
+    size_t AcquireSlot() {
+        while (true) {
+            for (size_t i = 0; i < EPOCH_MAX_THREADS; i++) {
+                bool used = false;
+                if (!slots_[i].used_.load(std::memory_order_relaxed) && slots_[i].used_.compare_exchange_strong(used, true)) {
+                    return i;
+                }
+            }
+            // every slot is taken, wait for a thread to exit
+            std::this_thread::yield();
+        }
+    }
+
+    std::atomic<uint64_t> global_epoch_;
+    Slot slots_[EPOCH_MAX_THREADS];
+    std::mutex mutex_;
+    std::vector<std::pair<uint64_t, std::shared_ptr<void>>> retired_;
+};
+
+// EpochGuard keeps the calling thread inside the epoch for its scope
+class EpochGuard {
+public:
+    explicit EpochGuard(EpochManager *manager = EpochManager::GetInstance()) : manager_(manager) { manager_->Enter(); }
+
+    ~EpochGuard() {
+        if (manager_ != nullptr) {
+            manager_->Exit();
+        }
+    }
+
+    EpochGuard(EpochGuard &&other) noexcept : manager_(other.manager_) { other.manager_ = nullptr; }
+    EpochGuard &operator=(EpochGuard &&other) = delete;
+    EpochGuard(const EpochGuard &) = delete;
+    EpochGuard &operator=(const EpochGuard &) = delete;
+
+private:
+    EpochManager *manager_;
+};
+} // namespace rangedb
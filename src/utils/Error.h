@@ -98,6 +98,7 @@ constexpr ErrorCode DB_NO_FILE_TO_SEARCH = ToDbErrorCode(13);
 constexpr ErrorCode DB_CREATE_RAW_INDEX = ToDbErrorCode(13);
 constexpr ErrorCode NO_NEED_BUILD_INDEX = ToDbErrorCode(14);
 constexpr ErrorCode DB_READ_BLOCK_ERROR = ToDbErrorCode(15);
+constexpr ErrorCode DB_WRITE_BLOCK_ERROR = ToDbErrorCode(16);
 
 // knowhere error code
 constexpr ErrorCode KNOWHERE_ERROR = ToKnowhereErrorCode(1);
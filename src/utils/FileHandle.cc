@@ -1,42 +1,128 @@
 #include "utils/FileHandle.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
 #include <fcntl.h>
+#include <iostream>
 #include <unistd.h>
+#include <vector>
 
 namespace rangedb {
 
 bool FileHandle::Open() {
+    if (direct_io_) {
+        fd_ = open(filename_.c_str(), O_RDWR | O_CREAT | O_DIRECT, 0666);
+        if (fd_ > 0 || errno != EINVAL) {
+            return fd_ > 0;
+        }
+        // the file system does not support O_DIRECT (e.g. tmpfs), fall back to buffered io
+        std::cout << "open " << filename_ << " with O_DIRECT failed, use buffered io" << std::endl;
+        direct_io_ = false;
+    }
     fd_ = open(filename_.c_str(), O_RDWR | O_CREAT, 0666);
     return fd_ > 0;
 }
 
 bool FileHandle::Read(void *buffer, size_t size, off64_t offset) {
-    off_t of = lseek(fd_, offset, SEEK_SET);
-    if (of == -1) {
-        return false;
+    int8_t *data = static_cast<int8_t *>(buffer);
+    while (size > 0) {
+        ssize_t read_size = pread64(fd_, data, size, offset);
+        if (read_size == -1 && errno == EINTR) {
+            continue;
+        }
+        if (read_size <= 0) {
+            // error or end of file
+            return false;
+        }
+        data += read_size;
+        offset += read_size;
+        size -= read_size;
     }
-    ssize_t data_size = read(fd_, buffer, size);
-    return data_size == size;
+    return true;
 }
 
 bool FileHandle::Write(const void *buffer, size_t size) {
-    ssize_t write_size = write(fd_, buffer, size);
-    if (write_size == -1) {
-        return false;
+    const int8_t *data = static_cast<const int8_t *>(buffer);
+    while (size > 0) {
+        ssize_t write_size = write(fd_, data, size);
+        if (write_size == -1 && errno == EINTR) {
+            continue;
+        }
+        if (write_size <= 0) {
+            return false;
+        }
+        data += write_size;
+        size -= write_size;
     }
-    // int error = fsync(fd_);
     return true;
 }
 
 bool FileHandle::WriteAt(const void *buffer, size_t size, off64_t offset) {
-    off_t of = lseek(fd_, offset, SEEK_SET);
-    if (of == -1) {
-        return false;
+    const int8_t *data = static_cast<const int8_t *>(buffer);
+    while (size > 0) {
+        ssize_t write_size = pwrite64(fd_, data, size, offset);
+        if (write_size == -1 && errno == EINTR) {
+            continue;
+        }
+        if (write_size <= 0) {
+            return false;
+        }
+        data += write_size;
+        offset += write_size;
+        size -= write_size;
+    }
+    return true;
+}
+
+// Skip the first done bytes of iov, returns the index of the first iovec not fully done
+static int AdvanceIovec(struct iovec *iov, int iovcnt, size_t done) {
+    int index = 0;
+    while (index < iovcnt && done >= iov[index].iov_len) {
+        done -= iov[index].iov_len;
+        index++;
+    }
+    if (index < iovcnt) {
+        iov[index].iov_base = static_cast<int8_t *>(iov[index].iov_base) + done;
+        iov[index].iov_len -= done;
     }
-    ssize_t write_size = write(fd_, buffer, size);
-    if (write_size == -1) {
-        return false;
+    return index;
+}
+
+bool FileHandle::ReadV(const struct iovec *iov, int iovcnt, off64_t offset) {
+    // work on a copy, it is advanced past the done part on short reads
+    std::vector<struct iovec> vec(iov, iov + iovcnt);
+    int index = 0;
+    while (index < iovcnt) {
+        int count = std::min(iovcnt - index, IOV_MAX);
+        ssize_t read_size = preadv64(fd_, vec.data() + index, count, offset);
+        if (read_size == -1 && errno == EINTR) {
+            continue;
+        }
+        if (read_size <= 0) {
+            return false;
+        }
+        offset += read_size;
+        index += AdvanceIovec(vec.data() + index, iovcnt - index, read_size);
+    }
+    return true;
+}
+
+bool FileHandle::WriteV(const struct iovec *iov, int iovcnt, off64_t offset) {
+    std::vector<struct iovec> vec(iov, iov + iovcnt);
+    int index = 0;
+    while (index < iovcnt) {
+        int count = std::min(iovcnt - index, IOV_MAX);
+        ssize_t write_size = pwritev64(fd_, vec.data() + index, count, offset);
+        if (write_size == -1 && errno == EINTR) {
+            continue;
+        }
+        if (write_size <= 0) {
+            return false;
+        }
+        offset += write_size;
+        index += AdvanceIovec(vec.data() + index, iovcnt - index, write_size);
     }
-    // int error = fsync(fd_);
     return true;
 }
 
@@ -2,23 +2,34 @@
 #include <cstdio>
 #include <memory>
 #include <string>
+#include <sys/uio.h>
 #include <unistd.h>
 
 namespace rangedb {
 class FileHandle {
 public:
-    FileHandle(const std::string &filename) : filename_(filename) {}
+    // With direct_io the file is opened with O_DIRECT, buffers, offsets and sizes
+    // passed to Read/Write must then be aligned to DIRECT_IO_ALIGNMENT.
+    FileHandle(const std::string &filename, bool direct_io = false) : filename_(filename), direct_io_(direct_io) {}
     bool Open();
+    // Read, WriteAt, ReadV and WriteV are positional and retry on short io, so
+    // they are safe to use from several threads on the same handle.
     bool Read(void *buffer, size_t size, off64_t offset);
     bool Write(const void *buffer, size_t size);
     bool WriteAt(const void *buffer, size_t size, off64_t offset);
+    // Scatter/gather io of iovcnt buffers starting at offset, split into chunks of IOV_MAX
+    bool ReadV(const struct iovec *iov, int iovcnt, off64_t offset);
+    bool WriteV(const struct iovec *iov, int iovcnt, off64_t offset);
     void Close();
     void Sync();
     void DeleteFile();
+    inline int GetFd() const { return fd_; }
+    inline bool IsDirectIO() const { return direct_io_; }
 
 private:
     std::string filename_;
     int fd_;
+    bool direct_io_;
 };
 using FileHandlePtr = std::shared_ptr<FileHandle>;
 } // namespace rangedb
\ No newline at end of file
@@ -19,7 +19,9 @@ struct FileInfo {
     uint8_t type;   // 0: mem, 1:sst 
     uint8_t status; // 0: normal, 1: deleted
     uint8_t level;
-    FileInfo() : file_id_(0), file_size_(0), block_num_(0), min_key_(), max_key_(), type(0), status(0), level(0) {}
+    // the memtable an sst file was flushed from, orders the level files on recovery
+    uint64_t mem_file_id_;
+    FileInfo() : file_id_(0), file_size_(0), block_num_(0), min_key_(), max_key_(), type(0), status(0), level(0), mem_file_id_(0) {}
     ~FileInfo() {}
     void Serialize(int8_t *buffer) const {
         size_t offset = 0;
@@ -46,6 +48,8 @@ struct FileInfo {
         std::memcpy(buffer + offset, &status, sizeof(uint8_t));
         offset += sizeof(uint8_t);
         std::memcpy(buffer + offset, &level, sizeof(uint8_t));
+        offset += sizeof(uint8_t);
+        std::memcpy(buffer + offset, &mem_file_id_, sizeof(uint64_t));
     }
     void Deserialize(const int8_t *buffer) {
         size_t offset = 0;
@@ -72,15 +76,22 @@ struct FileInfo {
         std::memcpy(&status, buffer + offset, sizeof(uint8_t));
         offset += sizeof(uint8_t);
         std::memcpy(&level, buffer + offset, sizeof(uint8_t));
+        offset += sizeof(uint8_t);
+        std::memcpy(&mem_file_id_, buffer + offset, sizeof(uint64_t));
     }
 
-    int Size() const { return sizeof(uint64_t) * 3 + sizeof(uint32_t) * 2 + min_key_.length_ + max_key_.length_ + 3 * sizeof(uint8_t); }
+    int Size() const { return sizeof(uint64_t) * 4 + sizeof(uint32_t) * 2 + min_key_.length_ + max_key_.length_ + 3 * sizeof(uint8_t); }
 };
 struct Manifest {
     uint64_t db_version_;
     uint64_t checkpoint_;
     uint64_t key_version_;
     uint64_t recode_num_;
+    // ids below it were given to wal block or sst files, 0 in a manifest written before it was kept
+    uint64_t next_file_id_;
+    // the last write batch spanning memtables that is committed, its parts in the wal block
+    // files are synced; 0 in a manifest written before it was kept
+    uint64_t batch_seq_;
     FileHandlePtr file_handle_ptr_;
     inline static std::shared_ptr<Manifest> instance = nullptr;
     /* data */
@@ -101,6 +112,8 @@ struct Manifest {
             checkpoint_ = 0;
             key_version_ = 0;
             recode_num_ = 0;
+            next_file_id_ = 0;
+            batch_seq_ = 0;
             Write();
         } else {
             Read();
@@ -119,6 +132,14 @@ struct Manifest {
         recode_num_ = recode_num;
         Write();
     }
+    void UpdateNextFileId(uint64_t next_file_id) {
+        next_file_id_ = next_file_id;
+        Write();
+    }
+    void UpdateBatchSeq(uint64_t batch_seq) {
+        batch_seq_ = batch_seq;
+        Write();
+    }
     void Serialize(int8_t *buffer) const {
         size_t offset = 0;
         std::memcpy(buffer, &MANIFEST_MAGIC, sizeof(uint64_t));
@@ -130,6 +151,10 @@ struct Manifest {
         std::memcpy(buffer + offset, &key_version_, sizeof(uint64_t));
         offset += sizeof(uint64_t);
         std::memcpy(buffer + offset, &recode_num_, sizeof(uint64_t));
+        offset += sizeof(uint64_t);
+        std::memcpy(buffer + offset, &next_file_id_, sizeof(uint64_t));
+        offset += sizeof(uint64_t);
+        std::memcpy(buffer + offset, &batch_seq_, sizeof(uint64_t));
     }
 
     void Deserialize(int8_t *buffer) {
@@ -146,6 +171,10 @@ struct Manifest {
         std::memcpy(&key_version_, buffer + offset, sizeof(uint64_t));
         offset += sizeof(uint64_t);
         std::memcpy(&recode_num_, buffer + offset, sizeof(uint64_t));
+        offset += sizeof(uint64_t);
+        std::memcpy(&next_file_id_, buffer + offset, sizeof(uint64_t));
+        offset += sizeof(uint64_t);
+        std::memcpy(&batch_seq_, buffer + offset, sizeof(uint64_t));
     }
 
     void Write() {
@@ -169,6 +198,22 @@ struct Manifest {
         UpdateRecodeNum(recode_num_ + 1);
     }
 
+    // Mark the record of file_id deleted, the files are loaded without it
+    void DeleteFileRecode(uint64_t file_id) {
+        auto buffer = std::make_unique<int8_t[]>(1024);
+        for (uint64_t i = 0; i < recode_num_; i++) {
+            file_handle_ptr_->Read(buffer.get(), sizeof(FileInfo), RECODE_START + i * sizeof(FileInfo));
+            FileInfo file_recode;
+            file_recode.Deserialize(buffer.get());
+            if (file_recode.file_id_ == file_id && file_recode.status == 0) {
+                file_recode.status = 1;
+                file_recode.Serialize(buffer.get());
+                file_handle_ptr_->WriteAt(buffer.get(), sizeof(FileInfo), RECODE_START + i * sizeof(FileInfo));
+                return;
+            }
+        }
+    }
+
     void ReadFileRecode(std::vector<FileInfo> *file_recode_list_) {
         for (uint64_t i = 0; i < recode_num_; i++) {
             auto buffer = std::make_unique<int8_t[]>(1024);
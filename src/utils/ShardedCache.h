@@ -0,0 +1,395 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace rangedb {
+// Hint passed by the reader on insert
+enum class CacheHint : uint8_t {
+    // foreground reads
+    NORMAL,
+    // background scans, the entry is evicted first unless it is hit again and
+    // its eviction does not leave a ghost behind
+    LOW_PRIORITY,
+    // do not insert at all, only update the entry if it is already cached
+    NO_FILL,
+};
+
+// ShardedCache splits the cache into 2^shard_bits shards selected by key hash.
+// The capacity is a budget of charges, every entry is charged what the caller
+// passes to Insert (e.g. its size in bytes). Every shard has its own lock and
+// evicts with S3-FIFO:
+//   - new entries go to a small fifo queue holding ~10% of the shard,
+//   - an entry leaving the small queue is moved to the main fifo queue if it
+//     was hit since it was inserted, otherwise it is dropped and its key kept
+//     in a ghost queue, a key found in the ghost queue is inserted to main,
+//   - an entry leaving the main queue is reinserted while its hit counter is
+//     not zero, the counter is decremented every time.
+// A hit only bumps a small counter, so Lookup needs just a shared lock and a
+// scan that touches every block once can not flush the entries hit more often.
+template <typename key_t, typename value_t, typename hash_t = std::hash<key_t>> class ShardedCache {
+public:
+    // Called with every entry the policy evicts, outside of the shard lock.
+    // Low priority entries and entries removed by Erase are not reported.
+    using EvictCallback = std::function<void(const key_t &key, const value_t &value)>;
+    // Takes over every value leaving the cache (evicted, erased or replaced)
+    // instead of releasing it, e.g. to defer its release to a reclamation epoch.
+    using RetireCallback = std::function<void(value_t &&value)>;
+
+private:
+    enum QueueType : uint8_t { SMALL_QUEUE, MAIN_QUEUE };
+    static const uint8_t MAX_FREQ = 3;
+
+    struct Node {
+        key_t key_;
+        value_t value_;
+        Node *prev_;
+        Node *next_;
+        size_t charge_;
+        std::atomic<uint8_t> freq_;
+        QueueType queue_;
+        bool low_priority_;
+    };
+
+    // values removed under the shard lock, reported and released once it is dropped
+    struct Removed {
+        bool report_;
+        bool retire_;
+        std::vector<std::pair<key_t, value_t>> evicted_;
+        std::vector<value_t> retired_;
+
+        void Drop(Node *node, bool evicted) {
+            if (evicted && report_) {
+                evicted_.emplace_back(std::move(node->key_), std::move(node->value_));
+            } else if (retire_) {
+                retired_.push_back(std::move(node->value_));
+            }
+            delete node;
+        }
+    };
+
+    // circular list, new entries are pushed at head_.next_ and evicted from head_.prev_
+    struct Queue {
+        Node head_;
+        size_t size_;
+        size_t usage_;
+
+        Queue() : size_(0), usage_(0) {
+            head_.prev_ = &head_;
+            head_.next_ = &head_;
+        }
+
+        inline void Unlink(Node *node) {
+            node->prev_->next_ = node->next_;
+            node->next_->prev_ = node->prev_;
+            size_--;
+            usage_ -= node->charge_;
+        }
+
+        inline void PushFront(Node *node) {
+            node->next_ = head_.next_;
+            node->prev_ = &head_;
+            head_.next_->prev_ = node;
+            head_.next_ = node;
+            size_++;
+            usage_ += node->charge_;
+        }
+
+        inline Node *Back() { return head_.prev_; }
+
+        void Clear() {
+            Node *node = head_.next_;
+            while (node != &head_) {
+                Node *next = node->next_;
+                delete node;
+                node = next;
+            }
+        }
+    };
+
+    struct alignas(64) Shard {
+        std::shared_mutex mutex_;
+        std::unordered_map<key_t, Node *, hash_t> map_;
+        Queue small_;
+        Queue main_;
+        std::list<key_t> ghost_;
+        std::unordered_map<key_t, typename std::list<key_t>::iterator, hash_t> ghost_map_;
+        size_t capacity_ = 0;
+        size_t small_capacity_ = 0;
+
+        ~Shard() {
+            small_.Clear();
+            main_.Clear();
+        }
+
+        Queue &GetQueue(Node *node) { return node->queue_ == SMALL_QUEUE ? small_ : main_; }
+
+        inline size_t Usage() const { return small_.usage_ + main_.usage_; }
+
+        void AddGhost(const key_t &key) {
+            // remember about as many keys as the cache holds
+            size_t ghost_capacity = std::max<size_t>(map_.size(), 1);
+            ghost_.push_front(key);
+            ghost_map_[key] = ghost_.begin();
+            while (ghost_.size() > ghost_capacity) {
+                ghost_map_.erase(ghost_.back());
+                ghost_.pop_back();
+            }
+        }
+
+        bool RemoveGhost(const key_t &key) {
+            auto it = ghost_map_.find(key);
+            if (it == ghost_map_.end()) {
+                return false;
+            }
+            ghost_.erase(it->second);
+            ghost_map_.erase(it);
+            return true;
+        }
+
+        // evicted entries worth keeping in a lower tier are reported
+        void EvictSmall(Removed *removed) {
+            Node *node = small_.Back();
+            small_.Unlink(node);
+            // a low priority entry needs one more hit to stay
+            uint8_t threshold = node->low_priority_ ? 2 : 1;
+            if (node->freq_.load(std::memory_order_relaxed) >= threshold) {
+                node->freq_.store(0, std::memory_order_relaxed);
+                node->queue_ = MAIN_QUEUE;
+                main_.PushFront(node);
+                return;
+            }
+            map_.erase(node->key_);
+            if (!node->low_priority_) {
+                AddGhost(node->key_);
+            }
+            removed->Drop(node, !node->low_priority_);
+        }
+
+        void EvictMain(Removed *removed) {
+            Node *node = main_.Back();
+            main_.Unlink(node);
+            uint8_t freq = node->freq_.load(std::memory_order_relaxed);
+            if (freq > 0) {
+                node->freq_.store(freq - 1, std::memory_order_relaxed);
+                main_.PushFront(node);
+                return;
+            }
+            map_.erase(node->key_);
+            removed->Drop(node, !node->low_priority_);
+        }
+
+        void Evict(Removed *removed) {
+            while (Usage() > capacity_) {
+                if (small_.usage_ > small_capacity_ || main_.size_ == 0) {
+                    EvictSmall(removed);
+                } else {
+                    EvictMain(removed);
+                }
+            }
+        }
+    };
+
+    std::vector<Shard> shards_;
+    uint32_t shard_mask_;
+    hash_t hasher_;
+    EvictCallback evict_callback_;
+    RetireCallback retire_callback_;
+
+    inline Removed NewRemoved() const { return Removed{evict_callback_ != nullptr, retire_callback_ != nullptr, {}, {}}; }
+
+    // called without the shard lock
+    inline void Release(Removed &removed) {
+        for (auto &entry : removed.evicted_) {
+            evict_callback_(entry.first, entry.second);
+            if (removed.retire_) {
+                retire_callback_(std::move(entry.second));
+            }
+        }
+        for (auto &value : removed.retired_) {
+            retire_callback_(std::move(value));
+        }
+    }
+
+    inline Shard &GetShard(const key_t &key) {
+        // mix the high bits in, the shard maps pick their buckets from the same hash
+        uint64_t hash = hasher_(key);
+        return shards_[(hash >> 32 ^ hash) & shard_mask_];
+    }
+
+public:
+    ShardedCache(size_t capacity, uint32_t shard_bits = 6) : shards_(1 << shard_bits), shard_mask_((1 << shard_bits) - 1) {
+        size_t shard_capacity = (capacity + shards_.size() - 1) / shards_.size();
+        for (auto &shard : shards_) {
+            shard.capacity_ = shard_capacity;
+            shard.small_capacity_ = shard.capacity_ / 10;
+        }
+    }
+
+    ShardedCache(const ShardedCache &) = delete;
+    ShardedCache &operator=(const ShardedCache &) = delete;
+
+    // Find key and copy its value out
+    bool Lookup(const key_t &key, value_t &value) {
+        Shard &shard = GetShard(key);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex_);
+        auto it = shard.map_.find(key);
+        if (it == shard.map_.end()) {
+            return false;
+        }
+        Node *node = it->second;
+        uint8_t freq = node->freq_.load(std::memory_order_relaxed);
+        if (freq < MAX_FREQ) {
+            // racing hits may lose an increment, the counter is only a hint
+            node->freq_.store(freq + 1, std::memory_order_relaxed);
+        }
+        value = node->value_;
+        return true;
+    }
+
+    // Find key and return the raw pointer held by its value without copying the
+    // value, for pointer-like values only. The pointer stays valid only as long
+    // as the caller guarantees the value is not released, e.g. with a retire
+    // callback deferring the release to a reclamation epoch the caller is in.
+    template <typename ptr_t> bool LookupRaw(const key_t &key, ptr_t &ptr) {
+        Shard &shard = GetShard(key);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex_);
+        auto it = shard.map_.find(key);
+        if (it == shard.map_.end()) {
+            return false;
+        }
+        Node *node = it->second;
+        uint8_t freq = node->freq_.load(std::memory_order_relaxed);
+        if (freq < MAX_FREQ) {
+            node->freq_.store(freq + 1, std::memory_order_relaxed);
+        }
+        ptr = node->value_.get();
+        return true;
+    }
+
+    void Insert(const key_t &key, const value_t &value, size_t charge = 1, CacheHint hint = CacheHint::NORMAL) {
+        Shard &shard = GetShard(key);
+        Removed removed = NewRemoved();
+        std::unique_lock<std::shared_mutex> lock(shard.mutex_);
+        auto it = shard.map_.find(key);
+        if (it != shard.map_.end()) {
+            Node *node = it->second;
+            Queue &queue = shard.GetQueue(node);
+            queue.usage_ = queue.usage_ - node->charge_ + charge;
+            node->charge_ = charge;
+            if (removed.retire_) {
+                removed.retired_.push_back(std::move(node->value_));
+            }
+            node->value_ = value;
+            shard.Evict(&removed);
+            lock.unlock();
+            Release(removed);
+            return;
+        }
+        if (hint == CacheHint::NO_FILL) {
+            return;
+        }
+        bool low_priority = hint == CacheHint::LOW_PRIORITY;
+        Node *node = new Node{key, value, nullptr, nullptr, charge, 0, SMALL_QUEUE, low_priority};
+        if (shard.RemoveGhost(key) && !low_priority) {
+            node->queue_ = MAIN_QUEUE;
+        }
+        shard.GetQueue(node).PushFront(node);
+        shard.map_.emplace(key, node);
+        shard.Evict(&removed);
+        lock.unlock();
+        Release(removed);
+    }
+
+    bool Erase(const key_t &key) {
+        Shard &shard = GetShard(key);
+        Removed removed = NewRemoved();
+        std::unique_lock<std::shared_mutex> lock(shard.mutex_);
+        auto it = shard.map_.find(key);
+        if (it == shard.map_.end()) {
+            return false;
+        }
+        Node *node = it->second;
+        shard.GetQueue(node).Unlink(node);
+        shard.map_.erase(it);
+        removed.Drop(node, false);
+        lock.unlock();
+        Release(removed);
+        return true;
+    }
+
+    bool Exists(const key_t &key) {
+        Shard &shard = GetShard(key);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex_);
+        return shard.map_.find(key) != shard.map_.end();
+    }
+
+    // Set before the cache is shared between threads
+    void SetEvictCallback(EvictCallback callback) { evict_callback_ = std::move(callback); }
+
+    // Set before the cache is shared between threads
+    void SetRetireCallback(RetireCallback callback) { retire_callback_ = std::move(callback); }
+
+    // Change the total capacity, entries over the new budget are evicted right away
+    void SetCapacity(size_t capacity) {
+        size_t shard_capacity = (capacity + shards_.size() - 1) / shards_.size();
+        for (auto &shard : shards_) {
+            Removed removed = NewRemoved();
+            std::unique_lock<std::shared_mutex> lock(shard.mutex_);
+            shard.capacity_ = shard_capacity;
+            shard.small_capacity_ = shard.capacity_ / 10;
+            shard.Evict(&removed);
+            lock.unlock();
+            Release(removed);
+        }
+    }
+
+    // Sum of the charges of all cached entries
+    size_t GetUsage() {
+        size_t usage = 0;
+        for (auto &shard : shards_) {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex_);
+            usage += shard.Usage();
+        }
+        return usage;
+    }
+
+    // Up to limit keys, hottest first: entries of the main queue by hit counter,
+    // then entries of the small queue by hit counter
+    std::vector<key_t> HotKeys(size_t limit) {
+        std::vector<std::pair<uint8_t, key_t>> entries;
+        for (auto &shard : shards_) {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex_);
+            for (Queue *queue : {&shard.main_, &shard.small_}) {
+                uint8_t base = queue == &shard.main_ ? MAX_FREQ + 1 : 0;
+                for (Node *node = queue->head_.next_; node != &queue->head_; node = node->next_) {
+                    entries.emplace_back(base + node->freq_.load(std::memory_order_relaxed), node->key_);
+                }
+            }
+        }
+        std::stable_sort(entries.begin(), entries.end(), [](const auto &a, const auto &b) { return a.first > b.first; });
+        std::vector<key_t> keys;
+        keys.reserve(std::min(limit, entries.size()));
+        for (size_t i = 0; i < entries.size() && i < limit; i++) {
+            keys.push_back(entries[i].second);
+        }
+        return keys;
+    }
+
+    size_t Size() {
+        size_t size = 0;
+        for (auto &shard : shards_) {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex_);
+            size += shard.map_.size();
+        }
+        return size;
+    }
+};
+} // namespace rangedb
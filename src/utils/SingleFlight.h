@@ -0,0 +1,61 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace rangedb {
+// SingleFlight coalesces concurrent calls for the same key: the first caller
+// runs the function, callers arriving while it runs wait for it and share its
+// result instead of running the function again. A key is only tracked while
+// its call is running, nothing is cached afterwards.
+template <typename key_t, typename value_t, typename hash_t = std::hash<key_t>> class SingleFlight {
+public:
+    // Run fn for key or wait for the call already running for key, shared is set
+    // to true if the result comes from another caller
+    template <typename func_t> value_t Do(const key_t &key, func_t &&fn, bool *shared = nullptr) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto it = calls_.find(key);
+        if (it != calls_.end()) {
+            std::shared_ptr<Call> call = it->second;
+            cv_.wait(lock, [&call]() { return call->done_; });
+            if (shared != nullptr) {
+                *shared = true;
+            }
+            return call->value_;
+        }
+        auto call = std::make_shared<Call>();
+        calls_.emplace(key, call);
+        lock.unlock();
+        value_t value = fn();
+        lock.lock();
+        call->value_ = value;
+        call->done_ = true;
+        calls_.erase(key);
+        lock.unlock();
+        cv_.notify_all();
+        if (shared != nullptr) {
+            *shared = false;
+        }
+        return value;
+    }
+
+    // Number of keys with a running call
+    size_t InflightNum() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return calls_.size();
+    }
+
+private:
+    struct Call {
+        bool done_ = false;
+        value_t value_;
+    };
+
+    std::mutex mutex_;
+    // misses are rare next to hits, one condition variable for every key is enough
+    std::condition_variable cv_;
+    std::unordered_map<key_t, std::shared_ptr<Call>, hash_t> calls_;
+};
+} // namespace rangedb
@@ -1,6 +1,7 @@
 #pragma once
 #include <cstdint>
 #include <cstring>
+#include <memory>
 #include <string>
 #include <unistd.h>
 
@@ -70,6 +71,8 @@ struct Slice {
     ByteKey key_;
     uint8_t value_frame_;
     resp::buffer data_;
+    // keeps the bytes data_ points to alive when a cache entry owns them
+    std::shared_ptr<const void> data_holder_;
     Slice() : version_(0), offset_(0), key_(), data_length_(0), data_("", 0) {}
     void Serialize(int8_t *buffer) const;
     void Deserialize(int8_t *buffer);
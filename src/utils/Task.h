@@ -21,6 +21,7 @@ struct Task {
     volatile bool done_ = false;
     storage::BlockFilePtr block_file_;
     bool flag;
+    ssize_t io_result_ = 0;
     Task(Slice *slice) : slice_(slice) {}
 };
 } // namespace rangedb
\ No newline at end of file
@@ -0,0 +1,48 @@
+#include "utils/AlignedBufferPool.h"
+#include "utils/FileHandle.h"
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <vector>
+
+using namespace rangedb;
+
+TEST(AlignedBufferPoolTest, reuse) {
+    AlignedBufferPool pool(64 * 1024, 2);
+    std::vector<int8_t *> buffers;
+    for (int i = 0; i < 4; i++) {
+        int8_t *buffer = pool.Allocate();
+        ASSERT_NE(buffer, nullptr);
+        ASSERT_EQ((uintptr_t)buffer % DIRECT_IO_ALIGNMENT, 0);
+        buffers.push_back(buffer);
+    }
+    for (auto buffer : buffers) {
+        pool.Release(buffer);
+    }
+    ASSERT_EQ(pool.GetFreeNum(), 2);
+    int8_t *buffer = pool.Allocate();
+    ASSERT_EQ(buffer, buffers[1]);
+    ASSERT_EQ(pool.GetFreeNum(), 1);
+    pool.Release(buffer);
+}
+
+TEST(AlignedBufferPoolTest, direct_io) {
+    AlignedBufferPool pool(64 * 1024, 4);
+    FileHandle file_handle("aligned_buffer_pool_test.sst", true);
+    ASSERT_TRUE(file_handle.Open());
+    int8_t *buffer = pool.Allocate();
+    for (size_t i = 0; i < pool.GetBufferSize(); i++) {
+        buffer[i] = i % 127;
+    }
+    ASSERT_TRUE(file_handle.WriteAt(buffer, pool.GetBufferSize(), 0));
+    int8_t *read_buffer = pool.Allocate();
+    ASSERT_TRUE(file_handle.Read(read_buffer, pool.GetBufferSize(), 0));
+    ASSERT_EQ(std::memcmp(buffer, read_buffer, pool.GetBufferSize()), 0);
+    pool.Release(buffer);
+    pool.Release(read_buffer);
+    file_handle.DeleteFile();
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest();
+    return RUN_ALL_TESTS();
+}
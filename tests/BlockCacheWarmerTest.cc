@@ -0,0 +1,37 @@
+#include "storage/block/BlockCacheWarmer.h"
+#include "storage/block/BlockManager.h"
+#include "storage/sstblock/SstBlock.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+using namespace rangedb;
+
+TEST(BlockCacheWarmerTest, dump_and_load) {
+    BlockManagerPtr block_manager = BlockManager::GetInstance();
+    for (size_t i = 0; i < 8; i++) {
+        block_manager->AddBlockCache(1, i, std::make_shared<storage::SstBlock>(i));
+    }
+    // block 5 is the hottest one
+    for (int i = 0; i < 3; i++) {
+        block_manager->GetBlock(1, 5);
+    }
+    BlockCacheWarmer warmer("block_cache_warmer_test.hot", 1000, 1024 * 1024, 4);
+    ASSERT_TRUE(warmer.Dump().ok());
+    std::vector<BlockCacheKey> keys;
+    ASSERT_TRUE(warmer.Load(&keys).ok());
+    ASSERT_EQ(keys.size(), 4);
+    ASSERT_EQ(keys[0], MakeBlockCacheKey(1, 5));
+    for (auto key : keys) {
+        ASSERT_TRUE(block_manager->IsBlockCached(BlockCacheKeyHigh(key), BlockCacheKeyLow(key)));
+    }
+    unlink("block_cache_warmer_test.hot");
+    BlockCacheWarmer missing("block_cache_warmer_missing.hot");
+    keys.clear();
+    ASSERT_FALSE(missing.Load(&keys).ok());
+    ASSERT_TRUE(keys.empty());
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest();
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,94 @@
+#include "storage/block/BlockIOSchedual.h"
+#include "coro/coro.hpp"
+#include "storage/FileManager.h"
+#include "storage/block/Block.h"
+#include "storage/sstblock/SstBlock.h"
+#include "storage/sstblock/SstBlockFile.h"
+#include "utils/FileHandle.h"
+#include "utils/Slice.h"
+#include "utils/Task.h"
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace rangedb;
+
+// an sst file of block_num blocks written around the block cache, so every block is cold
+storage::SstBlockFilePtr CreateColdSstFile(uint64_t file_id, size_t block_num) {
+    std::string file_name = std::to_string(file_id) + ".sst";
+    unlink(file_name.c_str());
+    FileHandle file_handle(file_name);
+    EXPECT_TRUE(file_handle.Open());
+    for (size_t i = 0; i < block_num; i++) {
+        storage::SstBlock block(i);
+        for (int j = 0; j < 100; j++) {
+            std::string str_key = "key" + std::to_string(j);
+            Slice slice;
+            slice.key_ = ByteKey((int8_t *)str_key.c_str(), str_key.size());
+            slice.data_ = resp::buffer((char *)"value", 5);
+            slice.data_length_ = slice.Size();
+            block.Append(&slice);
+        }
+        block.Finshed();
+        EXPECT_TRUE(file_handle.WriteAt(block.GetData(), storage::BLOCK_SIZE, storage::SstBlockFile::GetBlockOffset(i)));
+    }
+    file_handle.Close();
+    auto sst_file = std::make_shared<storage::SstBlockFile>(file_id);
+    FileManager::GetInstance()->AddBlockFile(file_id, sst_file);
+    return sst_file;
+}
+
+TEST(BlockIOSchedualTest, coalesce_cold_block) {
+    const uint64_t file_id = 900003;
+    const size_t round_num = 8;
+    const size_t task_num = 64;
+    auto sst_file = CreateColdSstFile(file_id, round_num);
+    BlockIOSchedual io_schedual(1);
+    auto wait = [](Task *task) -> coro::task<void> { co_await task->event_; };
+
+    // every round misses on its own cold block, the misses queued while the first read
+    // is in flight wait for it
+    bool single_read = false;
+    for (size_t round = 0; round < round_num; round++) {
+        uint64_t read_num = io_schedual.GetReadNum();
+        uint64_t coalesced_num = io_schedual.GetCoalescedNum();
+        std::vector<Slice> slices(task_num);
+        std::vector<std::unique_ptr<Task>> tasks;
+        for (auto &slice : slices) {
+            slice.file_id_ = file_id;
+            slice.block_id_ = round;
+            tasks.emplace_back(std::make_unique<Task>(&slice));
+            ASSERT_TRUE(io_schedual.ReadBlock(tasks.back().get()));
+        }
+        for (auto &task : tasks) {
+            coro::sync_wait(wait(task.get()));
+            ASSERT_TRUE(task->done_);
+            ASSERT_EQ(task->io_result_, (ssize_t)storage::BLOCK_SIZE);
+        }
+        ASSERT_NE(BlockManager::GetInstance()->GetBlock(file_id, round), nullptr);
+        uint64_t round_reads = io_schedual.GetReadNum() - read_num;
+        uint64_t round_coalesced = io_schedual.GetCoalescedNum() - coalesced_num;
+        // every miss is either read or coalesced with the read in flight
+        ASSERT_EQ(round_reads + round_coalesced, task_num);
+        if (round_reads == 1) {
+            single_read = true;
+        }
+    }
+    EXPECT_TRUE(single_read);
+    EXPECT_GT(io_schedual.GetCoalescedNum(), 0);
+
+    // misses after the stop are refused, nothing waits forever
+    io_schedual.Stop();
+    Slice slice;
+    slice.file_id_ = file_id;
+    Task task(&slice);
+    EXPECT_FALSE(io_schedual.ReadBlock(&task));
+    sst_file->GetFileHandle()->DeleteFile();
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest();
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,86 @@
+#include "storage/block/CompressedBlockCache.h"
+#include "storage/sstblock/SstBlock.h"
+#include "utils/Slice.h"
+#include <cstring>
+#include <gtest/gtest.h>
+#include <string>
+
+using namespace rangedb;
+
+storage::SstBlockPtr CreateSealedBlock(uint64_t block_id) {
+    storage::SstBlock block(block_id);
+    Slice slice;
+    for (int i = 0; i < 1000; i++) {
+        std::string str_key = "key" + std::to_string(i);
+        slice.key_ = ByteKey((int8_t *)str_key.c_str(), str_key.size());
+        slice.data_ = resp::buffer((char *)"value", 5);
+        slice.version_ = i;
+        slice.data_length_ = slice.Size();
+        if (block.GetSize() + slice.Size() > storage::BLOCK_SIZE) {
+            break;
+        }
+        block.Append(&slice);
+    }
+    block.Finshed();
+    // a block read back from a file
+    auto sealed_block = std::make_shared<storage::SstBlock>(block_id);
+    int8_t *data = storage::BlockBufferPool()->Allocate();
+    std::memcpy(data, block.GetData(), storage::BLOCK_SIZE);
+    sealed_block->InitFromData(data);
+    return sealed_block;
+}
+
+TEST(CompressedBlockCacheTest, base) {
+    CompressedBlockCache cache(16 * 1024 * 1024, 2);
+    auto block = CreateSealedBlock(3);
+    BlockCacheKey key = MakeBlockCacheKey(1, 3);
+    ASSERT_EQ(cache.Lookup(key), nullptr);
+    ASSERT_TRUE(cache.Insert(key, block));
+    auto stats = cache.GetStats();
+    ASSERT_EQ(stats.insert_, 1);
+    ASSERT_LT(stats.usage_, storage::BLOCK_SIZE);
+
+    storage::BlockPtr read_block = cache.Lookup(key);
+    ASSERT_NE(read_block, nullptr);
+    ASSERT_EQ(std::memcmp(read_block->GetData(), block->GetData(), storage::BLOCK_SIZE), 0);
+    // a hit moves the block back to the primary cache
+    ASSERT_EQ(cache.Lookup(key), nullptr);
+    stats = cache.GetStats();
+    ASSERT_EQ(stats.hit_, 1);
+    ASSERT_EQ(stats.miss_, 2);
+}
+
+TEST(CompressedBlockCacheTest, reject) {
+    CompressedBlockCache cache(16 * 1024 * 1024, 2);
+    // blocks still being built are not kept
+    auto block = std::make_shared<storage::SstBlock>(0);
+    ASSERT_FALSE(cache.Insert(MakeBlockCacheKey(1, 0), block));
+    // random records do not compress
+    int8_t *data = storage::BlockBufferPool()->Allocate();
+    std::memset(data, 0, storage::SSTBLOCK_HEAD_SIZE);
+    for (size_t i = storage::SSTBLOCK_HEAD_SIZE; i < storage::BLOCK_SIZE; i++) {
+        data[i] = rand();
+    }
+    auto random_block = std::make_shared<storage::SstBlock>(1);
+    random_block->InitFromData(data);
+    ASSERT_FALSE(cache.Insert(MakeBlockCacheKey(1, 1), random_block));
+    ASSERT_EQ(cache.GetStats().reject_, 1);
+}
+
+TEST(CompressedBlockCacheTest, set_capacity) {
+    CompressedBlockCache cache(16 * 1024 * 1024, 2);
+    for (uint64_t i = 0; i < 64; i++) {
+        ASSERT_TRUE(cache.Insert(MakeBlockCacheKey(1, i), CreateSealedBlock(i)));
+    }
+    size_t usage = cache.GetUsage();
+    ASSERT_GT(usage, 0);
+    // the memory governor shrinks the tier when the budget gets tight
+    cache.SetCapacity(usage / 4);
+    EXPECT_LE(cache.GetUsage(), usage / 4);
+    EXPECT_EQ(cache.GetUsage(), cache.GetStats().usage_);
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest();
+    return RUN_ALL_TESTS();
+}
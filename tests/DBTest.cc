@@ -1,7 +1,10 @@
 #include "server/DB.h"
 #include "storage/walblock/WalManager.h"
+#include <functional>
 #include <gtest/gtest.h>
-rangedb::DB *db = new rangedb::DB();
+#include <sys/wait.h>
+#include <unistd.h>
+rangedb::DB *db = nullptr;
 void DBTest() {
     rangedb::Slice *slice = new rangedb::Slice();
     // slice->key_ = rangedb::ByteKey((int8_t *)"key", 3);
@@ -18,7 +21,7 @@ void DBTest() {
 }
 
 void DBInitTest() {
-    db->Init();
+    db = new rangedb::DB();
     DBTest();
 }
 
@@ -60,6 +63,76 @@ void TestBechmark() {
     }
 }
 
+// Run phase in a child process that exits without shutting the DB down, as a crash does
+int RunCrashedProcess(const std::function<bool()> &phase) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        _exit(phase() ? 0 : 1);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+bool PutKeys(rangedb::DB *db, const std::string &prefix, int key_num) {
+    rangedb::WriteOptions options;
+    options.durability_ = rangedb::storage::MXLogDurability::Synced;
+    for (int i = 0; i < key_num; i++) {
+        std::string key = prefix + std::to_string(i);
+        rangedb::Slice slice;
+        slice.key_ = rangedb::ByteKey((int8_t *)key.c_str(), key.length());
+        slice.data_ = resp::buffer(key.c_str(), key.length());
+        if (!db->Put(&slice, options).ok()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool HasKeys(rangedb::DB *db, const std::string &prefix, int key_num) {
+    for (int i = 0; i < key_num; i++) {
+        std::string key = prefix + std::to_string(i);
+        rangedb::Slice slice;
+        slice.key_ = rangedb::ByteKey((int8_t *)key.c_str(), key.length());
+        if (!db->Get(&slice).ok() || std::string(slice.data_.data(), slice.data_.size()) != key) {
+            std::cout << "key " << key << " lost after restart" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+TEST(DBTest, restart_keeps_mutable_wal) {
+    char dir[] = "/tmp/rangedb_restart_XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    char cwd[4096];
+    ASSERT_NE(getcwd(cwd, sizeof(cwd)), nullptr);
+    ASSERT_EQ(chdir(dir), 0);
+    const int key_num = 1000;
+    // the keys only live in the wal block file of the mutable memtable
+    EXPECT_EQ(RunCrashedProcess([&]() { return PutKeys(new rangedb::DB(), "first_", key_num); }), 0);
+    // the restart flushes the recovered memtable while the new one takes writes, it must
+    // neither flush nor remove the file of the new one
+    EXPECT_EQ(RunCrashedProcess([&]() {
+                  rangedb::DB *db = new rangedb::DB();
+                  if (!HasKeys(db, "first_", key_num) || !PutKeys(db, "second_", key_num)) {
+                      return false;
+                  }
+                  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+                  // the flushed wal block file is gone from level 0 as well
+                  std::list<rangedb::FileInfo *> wal_files;
+                  rangedb::FileManager::GetInstance()->GetLevelFile(0, &wal_files);
+                  return wal_files.empty() && HasKeys(db, "first_", key_num);
+              }),
+              0);
+    EXPECT_EQ(RunCrashedProcess([&]() {
+                  rangedb::DB *db = new rangedb::DB();
+                  return HasKeys(db, "first_", key_num) && HasKeys(db, "second_", key_num);
+              }),
+              0);
+    ASSERT_EQ(chdir(cwd), 0);
+}
+
 TEST(DBTest, base) {
     rangedb::DB *db = new rangedb::DB();
     // DBInitTest();
@@ -0,0 +1,70 @@
+#include "utils/FileHandle.h"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+using namespace rangedb;
+
+TEST(FileHandleTest, vectored_io) {
+    const size_t buffer_size = 4096;
+    const int buffer_num = 2048; // more than IOV_MAX, WriteV/ReadV have to split
+    FileHandle file_handle("file_handle_test.data");
+    ASSERT_TRUE(file_handle.Open());
+    std::vector<std::vector<int8_t>> buffers(buffer_num, std::vector<int8_t>(buffer_size));
+    std::vector<struct iovec> iov(buffer_num);
+    for (int i = 0; i < buffer_num; i++) {
+        std::memset(buffers[i].data(), i % 127, buffer_size);
+        iov[i] = {buffers[i].data(), buffer_size};
+    }
+    ASSERT_TRUE(file_handle.WriteV(iov.data(), buffer_num, 0));
+
+    std::vector<std::vector<int8_t>> read_buffers(buffer_num, std::vector<int8_t>(buffer_size));
+    for (int i = 0; i < buffer_num; i++) {
+        iov[i] = {read_buffers[i].data(), buffer_size};
+    }
+    ASSERT_TRUE(file_handle.ReadV(iov.data(), buffer_num, 0));
+    for (int i = 0; i < buffer_num; i++) {
+        ASSERT_EQ(std::memcmp(buffers[i].data(), read_buffers[i].data(), buffer_size), 0);
+    }
+    // reading past the end of file fails
+    ASSERT_FALSE(file_handle.Read(read_buffers[0].data(), buffer_size, buffer_size * buffer_num));
+    file_handle.DeleteFile();
+}
+
+TEST(FileHandleTest, concurrent_read) {
+    const size_t buffer_size = 4096;
+    const int buffer_num = 64;
+    FileHandle file_handle("file_handle_concurrent_test.data");
+    ASSERT_TRUE(file_handle.Open());
+    std::vector<int8_t> buffer(buffer_size);
+    for (int i = 0; i < buffer_num; i++) {
+        std::memset(buffer.data(), i, buffer_size);
+        ASSERT_TRUE(file_handle.WriteAt(buffer.data(), buffer_size, i * buffer_size));
+    }
+    std::vector<std::thread> threads;
+    std::atomic<int> errors = 0;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&, t]() {
+            std::vector<int8_t> data(buffer_size);
+            for (int n = 0; n < 1000; n++) {
+                int i = (n * 7 + t) % buffer_num;
+                if (!file_handle.Read(data.data(), buffer_size, i * buffer_size) || data[0] != i || data[buffer_size - 1] != i) {
+                    errors++;
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    ASSERT_EQ(errors, 0);
+    file_handle.DeleteFile();
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest();
+    return RUN_ALL_TESTS();
+}
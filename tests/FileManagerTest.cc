@@ -0,0 +1,78 @@
+#include "storage/FileManager.h"
+#include "storage/sstblock/SstBlockFile.h"
+#include "utils/Manifest.h"
+#include "utils/Slice.h"
+#include <atomic>
+#include <gtest/gtest.h>
+#include <list>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace rangedb;
+
+const uint64_t TEST_FILE_ID_BASE = 900000;
+const int TEST_LEVEL = 1;
+
+ByteKey MakeKey(const std::string &str) { return ByteKey((int8_t *)str.c_str(), str.size()); }
+
+// a flush thread adds and a compaction removes level files while readers look them up
+TEST(FileManagerTest, concurrent_add_remove_lookup) {
+    FileManager *file_manager = FileManager::GetInstance();
+    const int file_num = 200;
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; i++) {
+        readers.emplace_back([&, i] {
+            while (!stop.load()) {
+                for (int j = 0; j < file_num; j++) {
+                    // the file may be there or not, it must not crash either way
+                    file_manager->GetBlockFile(TEST_FILE_ID_BASE + j);
+                }
+                std::list<FileInfo *> file_lst;
+                file_manager->GetLevelFile(TEST_LEVEL, &file_lst);
+                file_manager->BinaryRangeSearch(MakeKey("key" + std::to_string(i)), TEST_LEVEL);
+            }
+        });
+    }
+
+    std::thread writer([&] {
+        for (int j = 0; j < file_num; j++) {
+            uint64_t file_id = TEST_FILE_ID_BASE + j;
+            FileInfo *file_info = new FileInfo();
+            file_info->file_id_ = file_id;
+            file_info->level = TEST_LEVEL;
+            file_info->min_key_ = MakeKey("key");
+            file_info->max_key_ = MakeKey("kez");
+            file_manager->AddFileInfo(file_id, TEST_LEVEL, file_info);
+            file_manager->AddBlockFile(file_id, std::make_shared<storage::SstBlockFile>(file_id));
+            if (j % 2 == 1) {
+                file_manager->RemoveBlockFile(file_id - 1);
+            }
+        }
+    });
+    writer.join();
+    stop.store(true);
+    for (auto &reader : readers) {
+        reader.join();
+    }
+
+    for (int j = 0; j < file_num; j++) {
+        uint64_t file_id = TEST_FILE_ID_BASE + j;
+        if (j % 2 == 0) {
+            EXPECT_EQ(file_manager->GetBlockFile(file_id), nullptr);
+        } else {
+            EXPECT_NE(file_manager->GetBlockFile(file_id), nullptr);
+        }
+        unlink((std::to_string(file_id) + ".sst").c_str());
+    }
+    std::list<FileInfo *> file_lst;
+    file_manager->GetLevelFile(TEST_LEVEL, &file_lst);
+    EXPECT_EQ(file_lst.size(), file_num / 2);
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest();
+    return RUN_ALL_TESTS();
+}
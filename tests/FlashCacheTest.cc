@@ -0,0 +1,125 @@
+#include "storage/block/FlashCache.h"
+#include "storage/sstblock/SstBlock.h"
+#include "utils/CommonUtil.h"
+#include "utils/FileHandle.h"
+#include "utils/Slice.h"
+#include <cstring>
+#include <gtest/gtest.h>
+#include <string>
+
+using namespace rangedb;
+
+// writes a block to a file of the slow volume and reads it back as a sealed block
+storage::BlockPtr CreateBlockOnSlowVolume(const std::string &filename, uint64_t block_id) {
+    storage::SstBlock block(block_id);
+    Slice slice;
+    for (int i = 0; i < 1000; i++) {
+        std::string str_key = "key" + std::to_string(i);
+        slice.key_ = ByteKey((int8_t *)str_key.c_str(), str_key.size());
+        slice.data_ = resp::buffer((char *)"value", 5);
+        slice.version_ = i;
+        slice.data_length_ = slice.Size();
+        if (block.GetSize() + slice.Size() > storage::BLOCK_SIZE) {
+            break;
+        }
+        block.Append(&slice);
+    }
+    block.Finshed();
+    FileHandle file_handle(filename);
+    EXPECT_TRUE(file_handle.Open());
+    EXPECT_TRUE(file_handle.WriteAt(block.GetData(), storage::BLOCK_SIZE, 0));
+    int8_t *data = storage::BlockBufferPool()->Allocate();
+    EXPECT_TRUE(file_handle.Read(data, storage::BLOCK_SIZE, 0));
+    file_handle.Close();
+    auto sealed_block = std::make_shared<storage::SstBlock>(block_id);
+    sealed_block->InitFromData(data);
+    return sealed_block;
+}
+
+TEST(FlashCacheTest, survive_restart) {
+    ASSERT_TRUE(CommonUtil::CreateDirectory("flash_cache_slow").ok());
+    std::string slow_file = "flash_cache_slow/1.sst";
+    storage::BlockPtr block = CreateBlockOnSlowVolume(slow_file, 5);
+    BlockCacheKey key = MakeBlockCacheKey(1, 5);
+    {
+        FlashCache cache("flash_cache_fast", 8 * FLASH_CACHE_SLOT_SIZE);
+        ASSERT_TRUE(cache.Open().ok());
+        ASSERT_EQ(cache.Lookup(key), nullptr);
+        ASSERT_TRUE(cache.Insert(key, block));
+        cache.WaitForWrites();
+        ASSERT_EQ(cache.GetStats().insert_, 1);
+        cache.Close();
+    }
+    // the slow volume is gone, the block is served from the fast one
+    unlink(slow_file.c_str());
+    FlashCache cache("flash_cache_fast", 8 * FLASH_CACHE_SLOT_SIZE);
+    ASSERT_TRUE(cache.Open().ok());
+    storage::BlockPtr read_block = cache.Lookup(key);
+    ASSERT_NE(read_block, nullptr);
+    ASSERT_EQ(std::memcmp(read_block->GetData(), block->GetData(), storage::BLOCK_SIZE), 0);
+    Slice slice;
+    std::string str_key = "key7";
+    slice.key_ = ByteKey((int8_t *)str_key.c_str(), str_key.size());
+    ASSERT_TRUE(std::dynamic_pointer_cast<storage::SstBlock>(read_block)->Get(&slice));
+    cache.Erase(key);
+    ASSERT_EQ(cache.Lookup(key), nullptr);
+    cache.Close();
+    unlink("flash_cache_fast/flash_cache.data");
+    unlink("flash_cache_fast/flash_cache.index");
+}
+
+TEST(FlashCacheTest, ring_overwrite) {
+    ASSERT_TRUE(CommonUtil::CreateDirectory("flash_cache_slow").ok());
+    storage::BlockPtr block = CreateBlockOnSlowVolume("flash_cache_slow/2.sst", 0);
+    FlashCache cache("flash_cache_ring", 4 * FLASH_CACHE_SLOT_SIZE);
+    ASSERT_TRUE(cache.Open().ok());
+    for (uint64_t i = 0; i < 6; i++) {
+        ASSERT_TRUE(cache.Insert(MakeBlockCacheKey(2, i), block));
+        cache.WaitForWrites();
+    }
+    // the two oldest slots were reused
+    ASSERT_EQ(cache.Lookup(MakeBlockCacheKey(2, 0)), nullptr);
+    ASSERT_EQ(cache.Lookup(MakeBlockCacheKey(2, 1)), nullptr);
+    for (uint64_t i = 2; i < 6; i++) {
+        ASSERT_NE(cache.Lookup(MakeBlockCacheKey(2, i)), nullptr);
+    }
+    cache.Close();
+    unlink("flash_cache_slow/2.sst");
+    unlink("flash_cache_ring/flash_cache.data");
+    unlink("flash_cache_ring/flash_cache.index");
+}
+
+TEST(FlashCacheTest, scan_resumes_after_newest_slot) {
+    ASSERT_TRUE(CommonUtil::CreateDirectory("flash_cache_slow").ok());
+    storage::BlockPtr block = CreateBlockOnSlowVolume("flash_cache_slow/3.sst", 0);
+    {
+        FlashCache cache("flash_cache_scan", 4 * FLASH_CACHE_SLOT_SIZE);
+        ASSERT_TRUE(cache.Open().ok());
+        // the ring wraps, key 5 is in slot 1 and slot 2 holds the oldest block
+        for (uint64_t i = 0; i < 6; i++) {
+            ASSERT_TRUE(cache.Insert(MakeBlockCacheKey(3, i), block));
+            cache.WaitForWrites();
+        }
+        cache.Close();
+    }
+    // without the index the slots are scanned
+    unlink("flash_cache_scan/flash_cache.index");
+    FlashCache cache("flash_cache_scan", 4 * FLASH_CACHE_SLOT_SIZE);
+    ASSERT_TRUE(cache.Open().ok());
+    ASSERT_TRUE(cache.Insert(MakeBlockCacheKey(3, 6), block));
+    cache.WaitForWrites();
+    // the oldest block was overwritten, the newest ones are kept
+    ASSERT_EQ(cache.Lookup(MakeBlockCacheKey(3, 2)), nullptr);
+    for (uint64_t i = 3; i < 7; i++) {
+        ASSERT_NE(cache.Lookup(MakeBlockCacheKey(3, i)), nullptr);
+    }
+    cache.Close();
+    unlink("flash_cache_slow/3.sst");
+    unlink("flash_cache_scan/flash_cache.data");
+    unlink("flash_cache_scan/flash_cache.index");
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest();
+    return RUN_ALL_TESTS();
+}
@@ -1,8 +1,19 @@
 #include "table/LsmTable.h"
 
+#include "db/WriteBatch.h"
 #include "db/index/RingHashVec.h"
 #include "utils/Slice.h"
 #include "gtest/gtest.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <set>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <tuple>
+#include <unistd.h>
+#include <vector>
 
 TEST(MemFileTest, mem_file_test) {
     rangedb::RingHashVec *mem_vector = new rangedb::RingHashVec();
@@ -21,6 +32,466 @@ TEST(MemFileTest, mem_file_test) {
     slice1.Print();
 }
 
+TEST(LsmTableTest, write_stop) {
+    rangedb::RingHashVec *mem_vector = new rangedb::RingHashVec();
+    rangedb::LsmTableOptions options;
+    options.slowdown_num_ = 1;
+    options.stop_num_ = 1;
+    rangedb::LsmTable lsm_table(mem_vector, options);
+    for (int round = 0; round < 4; round++) {
+        for (int i = 0; i < 100; i++) {
+            rangedb::Slice slice;
+            std::string key = "key_" + std::to_string(round) + "_" + std::to_string(i);
+            slice.key_ = rangedb::ByteKey((int8_t *)key.data(), key.size());
+            slice.data_ = resp::buffer((char *)"value", 5);
+            slice.data_length_ = slice.Size();
+            // stops while the sealed memtable of the last round is flushed
+            ASSERT_TRUE(lsm_table.Put(&slice).ok());
+        }
+        lsm_table.RequestFlush();
+    }
+    EXPECT_GT(lsm_table.GetStopNum(), 0);
+    EXPECT_GT(lsm_table.GetStallMicros(), 0);
+}
+
+TEST(LsmTableTest, flush_points_index_to_sst) {
+    rangedb::RingHashVec *mem_vector = new rangedb::RingHashVec();
+    rangedb::LsmTable lsm_table(mem_vector);
+    std::string value(100, 'v');
+    const int key_num = 3000;
+    auto make_slice = [](rangedb::Slice *slice, const std::string &key) {
+        slice->key_ = rangedb::ByteKey((int8_t *)key.data(), key.size());
+    };
+    // several blocks, so the full ones go through the write stage before the last one
+    for (int i = 0; i < key_num; i++) {
+        rangedb::Slice slice;
+        make_slice(&slice, "key_" + std::to_string(i));
+        slice.data_ = resp::buffer(value.data(), value.size());
+        slice.data_length_ = slice.Size();
+        ASSERT_TRUE(lsm_table.Put(&slice).ok());
+    }
+    lsm_table.RequestFlush();
+    auto all_in_sst = [&]() {
+        int in_mem = 0;
+        for (int i = 0; i < key_num; i++) {
+            rangedb::Slice slice;
+            make_slice(&slice, "key_" + std::to_string(i));
+            if (!mem_vector->find(&slice) || slice.block_type_ != 1) {
+                in_mem++;
+            }
+        }
+        return in_mem == 0;
+    };
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!all_in_sst() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_TRUE(all_in_sst());
+}
+
+TEST(LsmTableTest, write_batch) {
+    rangedb::RingHashVec *mem_vector = new rangedb::RingHashVec();
+    // one stream takes the whole batch
+    rangedb::LsmTableOptions options;
+    options.stream_num_ = 1;
+    rangedb::LsmTable lsm_table(mem_vector, options);
+    rangedb::WriteBatch batch;
+    const int key_num = 1000;
+    for (int i = 0; i < key_num; i++) {
+        std::string key = "batch_" + std::to_string(i);
+        batch.Put(rangedb::ByteKey((int8_t *)key.data(), key.size()), "old", 3, 1);
+    }
+    // the later put of a key in the batch wins
+    std::string key = "batch_0";
+    batch.Put(rangedb::ByteKey((int8_t *)key.data(), key.size()), "new", 3, 2);
+
+    uint64_t lsn = 0;
+    ASSERT_TRUE(lsm_table.Write(&batch, rangedb::storage::MXLogDurability::Written, &lsn).ok());
+    EXPECT_GT(lsn, 0);
+    auto &slices = batch.GetSlices();
+    for (size_t i = 1; i < slices.size(); i++) {
+        // back to back in one memtable
+        EXPECT_EQ(slices[i].file_id_, slices[0].file_id_);
+        if (slices[i].block_id_ == slices[i - 1].block_id_) {
+            EXPECT_EQ(slices[i].offset_, slices[i - 1].offset_ + rangedb::storage::RecordSize(slices[i - 1]));
+        }
+    }
+    EXPECT_EQ(lsn >> 32, slices[0].file_id_);
+    // one lsn range covers the batch
+    EXPECT_EQ(batch.GetLastLsn(), lsn);
+    EXPECT_LT(batch.GetFirstLsn(), batch.GetLastLsn());
+    EXPECT_EQ(batch.GetFirstLsn() >> 32, slices[0].file_id_);
+
+    // indexed by the write
+    for (int i = 0; i < key_num; i++) {
+        std::string key = "batch_" + std::to_string(i);
+        rangedb::Slice slice;
+        slice.key_ = rangedb::ByteKey((int8_t *)key.data(), key.size());
+        ASSERT_TRUE(mem_vector->find(&slice));
+        EXPECT_EQ(slice.version_, i == 0 ? 2 : 1);
+    }
+}
+
+TEST(LsmTableTest, write_batch_across_streams) {
+    rangedb::RingHashVec mem_vector;
+    rangedb::LsmTableOptions options;
+    options.stream_num_ = 4;
+    rangedb::LsmTable lsm_table(&mem_vector, options);
+    rangedb::WriteBatch batch;
+    const int key_num = 1000;
+    for (int i = 0; i < key_num; i++) {
+        std::string key = "streams_" + std::to_string(i);
+        batch.Put(rangedb::ByteKey((int8_t *)key.data(), key.size()), "value", 5, 1);
+    }
+    uint64_t seq = rangedb::Manifest::ManifestGetInstance()->batch_seq_;
+    uint64_t lsn = 0;
+    ASSERT_TRUE(lsm_table.Write(&batch, rangedb::storage::MXLogDurability::Buffered, &lsn).ok());
+    // committed with the next sequence, the parts are synced already
+    EXPECT_EQ(rangedb::Manifest::ManifestGetInstance()->batch_seq_, seq + 1);
+    EXPECT_TRUE(lsm_table.WaitForSync(lsn));
+    std::set<uint64_t> file_ids;
+    for (auto &slice : batch.GetSlices()) {
+        file_ids.insert(slice.file_id_);
+        rangedb::Slice found;
+        found.key_ = slice.key_;
+        ASSERT_TRUE(mem_vector.find(&found));
+        EXPECT_EQ(found.file_id_, slice.file_id_);
+        EXPECT_EQ(found.offset_, slice.offset_);
+    }
+    // a part in the memtable of every stream
+    EXPECT_EQ(file_ids.size(), 4);
+}
+
+TEST(LsmTableTest, concurrent_puts_indexed_in_log_order) {
+    rangedb::RingHashVec *mem_vector = new rangedb::RingHashVec();
+    rangedb::LsmTable lsm_table(mem_vector);
+    std::string key = "same_key";
+    const int thread_num = 8;
+    const int put_num = 2000;
+    std::vector<std::vector<rangedb::Slice>> puts(thread_num);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_num; t++) {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; i < put_num; i++) {
+                rangedb::Slice slice;
+                slice.key_ = rangedb::ByteKey((int8_t *)key.data(), key.size());
+                slice.data_ = resp::buffer((char *)"value", 5);
+                slice.data_length_ = slice.Size();
+                ASSERT_TRUE(lsm_table.Put(&slice).ok());
+                puts[t].push_back(slice);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    // the index holds the put appended last
+    auto position = [](const rangedb::Slice &slice) { return std::make_tuple(slice.file_id_, slice.block_id_, slice.offset_); };
+    auto last = position(puts[0].back());
+    for (auto &thread_puts : puts) {
+        last = std::max(last, position(thread_puts.back()));
+    }
+    rangedb::Slice slice;
+    slice.key_ = rangedb::ByteKey((int8_t *)key.data(), key.size());
+    ASSERT_TRUE(mem_vector->find(&slice));
+    EXPECT_TRUE(position(slice) == last);
+}
+
+TEST(LsmTableTest, synced_puts_across_flushes) {
+    rangedb::RingHashVec *mem_vector = new rangedb::RingHashVec();
+    rangedb::LsmTable lsm_table(mem_vector);
+    std::atomic<bool> stop{false};
+    // the syncer syncs memtables the flush threads delete meanwhile
+    std::thread flusher([&]() {
+        while (!stop.load()) {
+            lsm_table.RequestFlush();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; t++) {
+        writers.emplace_back([&, t]() {
+            for (int i = 0; i < 200; i++) {
+                rangedb::Slice slice;
+                std::string key = "synced_" + std::to_string(t) + "_" + std::to_string(i);
+                slice.key_ = rangedb::ByteKey((int8_t *)key.data(), key.size());
+                slice.data_ = resp::buffer((char *)"value", 5);
+                slice.data_length_ = slice.Size();
+                ASSERT_TRUE(lsm_table.Put(&slice, rangedb::storage::MXLogDurability::Synced).ok());
+            }
+        });
+    }
+    for (auto &writer : writers) {
+        writer.join();
+    }
+    stop.store(true);
+    flusher.join();
+    EXPECT_EQ(lsm_table.GetSyncErrorNum(), 0);
+}
+
+TEST(LsmTableTest, mem_value_outlives_flush) {
+    rangedb::RingHashVec *mem_vector = new rangedb::RingHashVec();
+    rangedb::LsmTable lsm_table(mem_vector);
+    std::string key = "outlive";
+    std::string value(100, 'v');
+    rangedb::Slice slice;
+    slice.key_ = rangedb::ByteKey((int8_t *)key.data(), key.size());
+    slice.data_ = resp::buffer(value.data(), value.size());
+    ASSERT_TRUE(lsm_table.Put(&slice).ok());
+
+    rangedb::Slice read_slice = slice;
+    ASSERT_TRUE(lsm_table.GetFromMemBlock(&read_slice).ok());
+    // the memtable is flushed and freed while the value is still read
+    lsm_table.RequestFlush();
+    for (int i = 0; i < 1000; i++) {
+        rangedb::Slice probe = slice;
+        if (!lsm_table.GetFromMemBlock(&probe).ok()) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(std::string(read_slice.data_.data(), read_slice.data_.size()), value);
+}
+
+TEST(LsmTableTest, flush_replaces_wal_file) {
+    rangedb::RingHashVec *mem_vector = new rangedb::RingHashVec();
+    rangedb::LsmTable lsm_table(mem_vector);
+    rangedb::Slice slice;
+    std::string key = "replace_wal";
+    slice.key_ = rangedb::ByteKey((int8_t *)key.data(), key.size());
+    slice.data_ = resp::buffer((char *)"value", 5);
+    slice.data_length_ = slice.Size();
+    ASSERT_TRUE(lsm_table.Put(&slice, rangedb::storage::MXLogDurability::Written).ok());
+    uint64_t mem_file_id = slice.file_id_;
+    std::string wal_file = std::to_string(mem_file_id) + ".wal";
+    ASSERT_EQ(access(wal_file.c_str(), F_OK), 0);
+
+    lsm_table.RequestFlush();
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (access(wal_file.c_str(), F_OK) == 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_NE(access(wal_file.c_str(), F_OK), 0);
+    // a restart loads the sst file the memtable was flushed to instead of the wal block file
+    std::vector<rangedb::FileInfo> file_infos;
+    rangedb::Manifest::ManifestGetInstance()->ReadFileRecode(&file_infos);
+    bool wal_deleted = false;
+    bool sst_added = false;
+    for (auto &file_info : file_infos) {
+        if (file_info.file_id_ == mem_file_id) {
+            wal_deleted = file_info.status == 1;
+        }
+        if (file_info.level == 1 && file_info.mem_file_id_ == mem_file_id) {
+            sst_added = file_info.status == 0;
+            // the only record bounds the file
+            EXPECT_EQ(file_info.min_key_.ToString(), key);
+            EXPECT_EQ(file_info.max_key_.ToString(), key);
+        }
+    }
+    EXPECT_TRUE(wal_deleted);
+    EXPECT_TRUE(sst_added);
+}
+
+TEST(LsmTableTest, put_fails_without_wal_file) {
+    rangedb::RingHashVec *mem_vector = new rangedb::RingHashVec();
+    // one stream, the sealed memtable takes the next file id
+    rangedb::LsmTableOptions options;
+    options.stream_num_ = 1;
+    rangedb::LsmTable lsm_table(mem_vector, options);
+    auto put = [&](const std::string &key) {
+        rangedb::Slice slice;
+        slice.key_ = rangedb::ByteKey((int8_t *)key.data(), key.size());
+        slice.data_ = resp::buffer((char *)"value", 5);
+        slice.data_length_ = slice.Size();
+        rangedb::Status status = lsm_table.Put(&slice, rangedb::storage::MXLogDurability::Written);
+        return std::make_pair(status.ok(), slice.file_id_);
+    };
+    auto first = put("no_wal_0");
+    ASSERT_TRUE(first.first);
+    // the memtable sealed next can not open its file over a directory
+    std::string wal_file = std::to_string(first.second + 1) + ".wal";
+    ASSERT_EQ(mkdir(wal_file.c_str(), 0755), 0);
+    lsm_table.RequestFlush();
+    EXPECT_FALSE(put("no_wal_1").first);
+    // the file is opened again by the next put
+    rmdir(wal_file.c_str());
+    auto last = put("no_wal_2");
+    ASSERT_TRUE(last.first);
+    EXPECT_EQ(last.second, first.second + 1);
+    struct stat file_stat;
+    ASSERT_EQ(stat(wal_file.c_str(), &file_stat), 0);
+    EXPECT_TRUE(S_ISREG(file_stat.st_mode));
+    EXPECT_GT(file_stat.st_size, 0);
+}
+
+TEST(LsmTableTest, flush_retry) {
+    rangedb::RingHashVec *mem_vector = new rangedb::RingHashVec();
+    rangedb::LsmTable lsm_table(mem_vector);
+    const int key_num = 100;
+    auto make_slice = [](rangedb::Slice *slice, int i) {
+        std::string key = "retry_" + std::to_string(i);
+        slice->key_ = rangedb::ByteKey((int8_t *)key.data(), key.size());
+    };
+    uint64_t mem_file_id = 0;
+    for (int i = 0; i < key_num; i++) {
+        rangedb::Slice slice;
+        make_slice(&slice, i);
+        slice.data_ = resp::buffer((char *)"value", 5);
+        slice.data_length_ = slice.Size();
+        ASSERT_TRUE(lsm_table.Put(&slice).ok());
+        mem_file_id = slice.file_id_;
+    }
+    // the seal takes the next id for the new memtable, the first flush the one after, its
+    // sst file can not be opened over a directory
+    std::string failed_sst = std::to_string(mem_file_id + 2) + ".sst";
+    ASSERT_EQ(mkdir(failed_sst.c_str(), 0755), 0);
+    lsm_table.RequestFlush();
+    auto all_in_sst = [&]() {
+        for (int i = 0; i < key_num; i++) {
+            rangedb::Slice slice;
+            make_slice(&slice, i);
+            if (!mem_vector->find(&slice) || slice.block_type_ != 1) {
+                return false;
+            }
+        }
+        return true;
+    };
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!all_in_sst() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    rmdir(failed_sst.c_str());
+    EXPECT_GT(lsm_table.GetFlushErrorNum(), 0);
+    EXPECT_EQ(rangedb::FileManager::GetInstance()->GetBlockFile(mem_file_id + 2), nullptr);
+    // the retry wrote a new file and the index points to it
+    EXPECT_TRUE(all_in_sst());
+    EXPECT_FALSE(lsm_table.IsWriteStopped());
+}
+
+// The wal block file a restart finds of a memtable that put every key rounds times, the last
+// round is the newest version
+rangedb::WalBlockFilePtr WriteMemFile(uint64_t file_id, const std::string &prefix, int key_num, int rounds) {
+    {
+        rangedb::WalBlockFile file(file_id);
+        EXPECT_TRUE(file.Open().ok());
+        for (int round = 1; round <= rounds; round++) {
+            for (int i = 0; i < key_num; i++) {
+                rangedb::Slice slice;
+                std::string key = prefix + std::to_string(i);
+                slice.key_ = rangedb::ByteKey((int8_t *)key.data(), key.size());
+                slice.data_ = resp::buffer((char *)"value", 5);
+                slice.version_ = round;
+                slice.data_length_ = slice.Size();
+                file.Append(&slice);
+            }
+        }
+        EXPECT_TRUE(file.Flush().ok());
+    }
+    auto file = std::make_shared<rangedb::WalBlockFile>(file_id);
+    EXPECT_TRUE(file->Load().ok());
+    return file;
+}
+
+TEST(LsmTableTest, recover_in_log_order) {
+    const int key_num = 5000;
+    const int rounds = 3;
+    std::vector<rangedb::WalBlockFilePtr> files{WriteMemFile(800001, "replay_", key_num, rounds),
+                                                 WriteMemFile(800000, "replay_", key_num, rounds - 1)};
+    ASSERT_GT(files[0]->GetBlockNum(), 1);
+    rangedb::RingHashVec mem_vector;
+    rangedb::LsmTableOptions options;
+    options.recover_thread_num_ = 4;
+    rangedb::LsmTable lsm_table(&mem_vector, options);
+    // the files are replayed by file id, the appliers split the keys
+    EXPECT_EQ(lsm_table.Recover(files), (uint64_t)key_num * (2 * rounds - 1));
+    for (int i = 0; i < key_num; i++) {
+        rangedb::Slice slice;
+        std::string key = "replay_" + std::to_string(i);
+        slice.key_ = rangedb::ByteKey((int8_t *)key.data(), key.size());
+        ASSERT_TRUE(mem_vector.find(&slice));
+        EXPECT_EQ(slice.version_, rounds);
+    }
+}
+
+TEST(LsmTableTest, recover_drops_uncommitted_batch) {
+    rangedb::ManifestPtr manifest = rangedb::Manifest::ManifestGetInstance();
+    uint64_t committed = manifest->batch_seq_ + 1;
+    manifest->UpdateBatchSeq(committed);
+    // a put and a part of a committed batch, then a put and a part of a batch the restart
+    // came before the commit of
+    auto write_file = [](uint64_t file_id, const std::string &prefix, uint64_t seq) {
+        {
+            rangedb::WalBlockFile file(file_id);
+            EXPECT_TRUE(file.Open().ok());
+            std::vector<rangedb::Slice> slices(3);
+            for (size_t i = 0; i < slices.size(); i++) {
+                std::string key = prefix + std::to_string(i);
+                slices[i].key_ = rangedb::ByteKey((int8_t *)key.data(), key.size());
+                slices[i].data_ = resp::buffer((char *)"value", 5);
+            }
+            file.Append(&slices[0]);
+            std::vector<rangedb::Slice> part(slices.begin() + 1, slices.end());
+            file.AppendBatch(part, seq);
+            EXPECT_TRUE(file.Flush().ok());
+        }
+        auto file = std::make_shared<rangedb::WalBlockFile>(file_id);
+        EXPECT_TRUE(file->Load().ok());
+        return file;
+    };
+    rangedb::RingHashVec mem_vector;
+    rangedb::LsmTable lsm_table(&mem_vector);
+    EXPECT_EQ(lsm_table.Recover({write_file(800030, "committed_", committed), write_file(800031, "uncommitted_", committed + 1)}), 4);
+    auto find = [&mem_vector](const std::string &key) {
+        rangedb::Slice slice;
+        slice.key_ = rangedb::ByteKey((int8_t *)key.data(), key.size());
+        return mem_vector.find(&slice);
+    };
+    EXPECT_TRUE(find("committed_2"));
+    EXPECT_TRUE(find("uncommitted_0"));
+    EXPECT_FALSE(find("uncommitted_1"));
+    // the next batch does not take the sequence again
+    rangedb::WriteBatch batch;
+    for (int i = 0; i < 100; i++) {
+        std::string key = "after_" + std::to_string(i);
+        batch.Put(rangedb::ByteKey((int8_t *)key.data(), key.size()), "value", 5);
+    }
+    ASSERT_TRUE(lsm_table.Write(&batch).ok());
+    EXPECT_EQ(manifest->batch_seq_, committed + 2);
+}
+
+TEST(LsmTableTest, recover_keeps_newer_sst) {
+    const uint64_t mem_file_id = 800010;
+    const uint64_t sst_file_id = 800020;
+    rangedb::RingHashVec mem_vector;
+    // a newer memtable was flushed before the restart, the older one was not
+    rangedb::FileInfo *file_info = new rangedb::FileInfo();
+    file_info->file_id_ = sst_file_id;
+    file_info->level = 1;
+    file_info->type = 1;
+    file_info->mem_file_id_ = mem_file_id + 1;
+    rangedb::FileManager::GetInstance()->AddFileInfo(sst_file_id, 1, file_info);
+    rangedb::Slice flushed;
+    std::string key = "older_0";
+    flushed.key_ = rangedb::ByteKey((int8_t *)key.data(), key.size());
+    flushed.block_type_ = 1;
+    flushed.file_id_ = sst_file_id;
+    flushed.version_ = 10;
+    mem_vector.insert(&flushed);
+
+    rangedb::LsmTable lsm_table(&mem_vector);
+    EXPECT_EQ(lsm_table.Recover({WriteMemFile(mem_file_id, "older_", 2, 1)}), 1);
+    rangedb::Slice slice;
+    slice.key_ = flushed.key_;
+    ASSERT_TRUE(mem_vector.find(&slice));
+    EXPECT_EQ(slice.file_id_, sst_file_id);
+    EXPECT_EQ(slice.version_, 10);
+    slice = rangedb::Slice();
+    key = "older_1";
+    slice.key_ = rangedb::ByteKey((int8_t *)key.data(), key.size());
+    EXPECT_TRUE(mem_vector.find(&slice));
+    rangedb::FileManager::GetInstance()->RemoveBlockFile(sst_file_id);
+}
+
 int main(int argc, char **argv) {
     testing::InitGoogleTest();
     return RUN_ALL_TESTS();
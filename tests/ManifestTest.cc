@@ -32,6 +32,30 @@ void ManifestTest() {
 
 TEST(ManifestTest, base) { ManifestTest(); }
 
+TEST(ManifestTest, delete_file_recode) {
+    Manifest manifest;
+    uint64_t recode_num = manifest.recode_num_;
+    FileInfo wal_info;
+    wal_info.file_id_ = 800001;
+    manifest.AppendFileRecode(&wal_info);
+    FileInfo sst_info;
+    sst_info.file_id_ = 800002;
+    sst_info.type = 1;
+    sst_info.level = 1;
+    sst_info.mem_file_id_ = wal_info.file_id_;
+    manifest.AppendFileRecode(&sst_info);
+    manifest.DeleteFileRecode(wal_info.file_id_);
+
+    std::vector<FileInfo> file_info_vec;
+    manifest.ReadFileRecode(&file_info_vec);
+    ASSERT_EQ(file_info_vec.size(), recode_num + 2);
+    EXPECT_EQ(file_info_vec[recode_num].file_id_, wal_info.file_id_);
+    EXPECT_EQ(file_info_vec[recode_num].status, 1);
+    EXPECT_EQ(file_info_vec[recode_num + 1].status, 0);
+    EXPECT_EQ(file_info_vec[recode_num + 1].level, 1);
+    EXPECT_EQ(file_info_vec[recode_num + 1].mem_file_id_, wal_info.file_id_);
+}
+
 int main(int argc, char **argv) {
     testing::InitGoogleTest();
     return RUN_ALL_TESTS();
@@ -0,0 +1,93 @@
+#include "db/mem/MemoryGovernor.h"
+#include <atomic>
+#include <chrono>
+#include <gtest/gtest.h>
+#include <thread>
+
+using namespace rangedb;
+
+TEST(MemoryGovernorTest, shrink_cache) {
+    db::MemoryGovernor governor(1000);
+    size_t memtable_usage = 200;
+    size_t cache_capacity = 0;
+    governor.RegisterConsumer(db::MemoryComponent::MEMTABLE, [&]() { return memtable_usage; });
+    governor.RegisterCache(
+        db::MemoryComponent::BLOCK_CACHE, [&]() { return cache_capacity; }, [&](size_t capacity) { cache_capacity = capacity; }, 1600);
+    governor.Update();
+    // the cache gets what the memtable leaves
+    ASSERT_EQ(cache_capacity, 800);
+    memtable_usage = 500;
+    governor.Update();
+    ASSERT_EQ(cache_capacity, 500);
+    ASSERT_EQ(governor.GetUsage(db::MemoryComponent::MEMTABLE), 500);
+    // usage is polled before the caches are resized
+    ASSERT_EQ(governor.GetUsage(db::MemoryComponent::BLOCK_CACHE), 800);
+    governor.Update();
+    ASSERT_EQ(governor.GetTotalUsage(), 1000);
+    // never below the minimum
+    memtable_usage = 2000;
+    governor.Update();
+    ASSERT_EQ(cache_capacity, 1600 / db::MEMORY_CACHE_MIN_DIVISOR);
+}
+
+TEST(MemoryGovernorTest, flush_and_stall) {
+    db::MemoryGovernor governor(1000, 1);
+    std::atomic<size_t> memtable_usage = 100;
+    std::atomic<int> flush_num = 0;
+    governor.RegisterConsumer(db::MemoryComponent::MEMTABLE, [&]() { return memtable_usage.load(); });
+    governor.SetFlushCallback([&]() { flush_num++; });
+    governor.Update();
+    ASSERT_EQ(flush_num, 0);
+    ASSERT_FALSE(governor.IsStalled());
+    memtable_usage = 700;
+    governor.Update();
+    ASSERT_EQ(flush_num, 1);
+    ASSERT_FALSE(governor.IsStalled());
+    memtable_usage = 990;
+    governor.Update();
+    ASSERT_TRUE(governor.IsStalled());
+
+    governor.Start();
+    std::atomic<bool> written = false;
+    std::thread writer([&]() {
+        governor.WaitForWrite();
+        written = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    ASSERT_FALSE(written);
+    // a flush freed the memtables
+    memtable_usage = 100;
+    writer.join();
+    ASSERT_TRUE(written);
+    ASSERT_FALSE(governor.IsStalled());
+    governor.Stop();
+}
+
+TEST(MemoryGovernorTest, index_over_budget) {
+    db::MemoryGovernor governor(1000);
+    size_t index_usage = 1200;
+    size_t memtable_usage = 10;
+    int flush_num = 0;
+    governor.RegisterConsumer(db::MemoryComponent::INDEX, [&]() { return index_usage; });
+    governor.RegisterConsumer(db::MemoryComponent::MEMTABLE, [&]() { return memtable_usage; });
+    governor.SetFlushCallback([&]() { flush_num++; });
+    governor.Update();
+    // flushes can not shrink the index, small memtables are neither flushed nor stalled
+    ASSERT_TRUE(governor.IsIndexOverBudget());
+    ASSERT_EQ(flush_num, 0);
+    ASSERT_FALSE(governor.IsStalled());
+    // the memtables keep their minimum share of the budget
+    memtable_usage = 1000 / db::MEMORY_MEMTABLE_MIN_DIVISOR;
+    governor.Update();
+    ASSERT_EQ(flush_num, 1);
+    ASSERT_TRUE(governor.IsStalled());
+    index_usage = 100;
+    governor.Update();
+    ASSERT_FALSE(governor.IsIndexOverBudget());
+    ASSERT_FALSE(governor.IsStalled());
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest();
+    return RUN_ALL_TESTS();
+}
@@ -180,6 +180,80 @@ TEST(RangeSkiplistTest, base) {
     // TestHash();
 }
 
+TEST(RingHashVecTest, try_insert) {
+    rangedb::RingHashVec *ring_index = new rangedb::RingHashVec();
+    rangedb::Slice slice;
+    slice.key_ = rangedb::ByteKey((int8_t *)"key", 3);
+    slice.file_id_ = 1;
+    slice.block_id_ = 2;
+    slice.offset_ = 16;
+    rangedb::Slice moved = slice;
+    moved.block_type_ = 1;
+    moved.file_id_ = 7;
+    // a missing key is not inserted
+    ASSERT_FALSE(ring_index->TryInsert(&slice, &moved));
+    ring_index->insert(&slice);
+
+    // a newer put of the key moved it, the stale replace is refused
+    rangedb::Slice newer = slice;
+    newer.offset_ = 64;
+    ring_index->insert(&newer);
+    ASSERT_FALSE(ring_index->TryInsert(&slice, &moved));
+    rangedb::Slice current;
+    current.key_ = slice.key_;
+    ASSERT_TRUE(ring_index->find(&current));
+    ASSERT_EQ(current.file_id_, 1);
+    ASSERT_EQ(current.offset_, 64);
+
+    ASSERT_TRUE(ring_index->TryInsert(&newer, &moved));
+    ASSERT_TRUE(ring_index->find(&current));
+    ASSERT_EQ(current.block_type_, 1);
+    ASSERT_EQ(current.file_id_, 7);
+}
+
+TEST(RingHashVecTest, batch_visible_at_once) {
+    rangedb::RingHashVec *ring_index = new rangedb::RingHashVec();
+    // two keys of different partitions, a batch puts both with the same version
+    std::vector<std::string> keys{"batch_a"};
+    for (int i = 0; keys.size() < 2; i++) {
+        std::string key = "batch_b" + std::to_string(i);
+        if (ring_index->GetRingIndex(rangedb::ByteKey((int8_t *)key.data(), key.size()).hash_0_) !=
+            ring_index->GetRingIndex(rangedb::ByteKey((int8_t *)keys[0].data(), keys[0].size()).hash_0_)) {
+            keys.push_back(key);
+        }
+    }
+    const uint64_t version_num = 100000;
+    std::atomic<bool> torn{false};
+    std::thread reader([&]() {
+        uint64_t last = 0;
+        while (last < version_num) {
+            rangedb::Slice first;
+            first.key_ = rangedb::ByteKey((int8_t *)keys[0].data(), keys[0].size());
+            rangedb::Slice second;
+            second.key_ = rangedb::ByteKey((int8_t *)keys[1].data(), keys[1].size());
+            if (!ring_index->find(&first)) {
+                continue;
+            }
+            // the second key is put with the first, it is never older
+            if (!ring_index->find(&second) || second.version_ < first.version_) {
+                torn = true;
+                break;
+            }
+            last = first.version_;
+        }
+    });
+    for (uint64_t version = 1; version <= version_num; version++) {
+        std::vector<rangedb::Slice> batch(2);
+        for (int i = 0; i < 2; i++) {
+            batch[i].key_ = rangedb::ByteKey((int8_t *)keys[i].data(), keys[i].size());
+            batch[i].version_ = version;
+        }
+        ring_index->insert(batch);
+    }
+    reader.join();
+    EXPECT_FALSE(torn);
+}
+
 int main(int argc, char **argv) {
     testing::InitGoogleTest();
     return RUN_ALL_TESTS();
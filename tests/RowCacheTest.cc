@@ -0,0 +1,65 @@
+#include "db/cache/RowCache.h"
+#include "utils/Slice.h"
+#include <gtest/gtest.h>
+#include <string>
+
+using namespace rangedb;
+
+Slice CreateSlice(const std::string &key, const char *value, uint64_t file_id) {
+    Slice slice;
+    slice.key_ = ByteKey((int8_t *)key.c_str(), key.size());
+    slice.data_ = resp::buffer(value, std::strlen(value));
+    slice.file_id_ = file_id;
+    slice.block_id_ = 2;
+    slice.offset_ = 16;
+    return slice;
+}
+
+TEST(RowCacheTest, base) {
+    RowCache cache(1024 * 1024);
+    Slice slice = CreateSlice("key1", "value1", 1);
+    cache.Insert(&slice);
+
+    Slice read_slice = CreateSlice("key1", "", 1);
+    ASSERT_TRUE(cache.Lookup(&read_slice));
+    ASSERT_EQ(std::string(read_slice.data_.data(), read_slice.data_.size()), "value1");
+
+    Slice missing = CreateSlice("key2", "", 1);
+    ASSERT_FALSE(cache.Lookup(&missing));
+    cache.Erase(slice.key_);
+    ASSERT_FALSE(cache.Lookup(&read_slice));
+}
+
+TEST(RowCacheTest, position) {
+    RowCache cache(1024 * 1024);
+    Slice slice = CreateSlice("key1", "value1", 1);
+    cache.Insert(&slice);
+    // the key was rewritten and flushed to another sst file, the index points there
+    Slice read_slice = CreateSlice("key1", "", 2);
+    ASSERT_FALSE(cache.Lookup(&read_slice));
+    Slice moved_slice = CreateSlice("key1", "", 1);
+    moved_slice.offset_ = 32;
+    ASSERT_FALSE(cache.Lookup(&moved_slice));
+    Slice new_slice = CreateSlice("key1", "value2", 2);
+    cache.Insert(&new_slice);
+    ASSERT_TRUE(cache.Lookup(&read_slice));
+    ASSERT_EQ(std::string(read_slice.data_.data(), read_slice.data_.size()), "value2");
+}
+
+TEST(RowCacheTest, value_outlives_entry) {
+    RowCache cache(1024 * 1024);
+    Slice slice = CreateSlice("key1", "value1", 1);
+    cache.Insert(&slice);
+    Slice read_slice = CreateSlice("key1", "", 1);
+    ASSERT_TRUE(cache.Lookup(&read_slice));
+    // evicted or replaced while the caller still reads the value
+    cache.Erase(slice.key_);
+    Slice new_slice = CreateSlice("key1", "value2", 2);
+    cache.Insert(&new_slice);
+    ASSERT_EQ(std::string(read_slice.data_.data(), read_slice.data_.size()), "value1");
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest();
+    return RUN_ALL_TESTS();
+}
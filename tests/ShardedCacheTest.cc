@@ -0,0 +1,193 @@
+#include "utils/ShardedCache.h"
+#include <atomic>
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace rangedb;
+
+TEST(ShardedCacheTest, base) {
+    ShardedCache<size_t, int> cache(1024, 2);
+    for (int i = 0; i < 100; i++) {
+        cache.Insert(i, i);
+    }
+    for (int i = 0; i < 100; i++) {
+        int value = 0;
+        ASSERT_TRUE(cache.Lookup(i, value));
+        ASSERT_EQ(value, i);
+    }
+    cache.Insert(1, 10);
+    int value = 0;
+    ASSERT_TRUE(cache.Lookup(1, value));
+    ASSERT_EQ(value, 10);
+    ASSERT_TRUE(cache.Erase(1));
+    ASSERT_FALSE(cache.Lookup(1, value));
+    ASSERT_FALSE(cache.Exists(1));
+    ASSERT_EQ(cache.Size(), 99);
+}
+
+TEST(ShardedCacheTest, evict) {
+    // one shard so the eviction order is easy to check
+    ShardedCache<std::string, int> cache(10, 0);
+    for (int i = 0; i < 10; i++) {
+        cache.Insert(std::to_string(i), i);
+    }
+    int value = 0;
+    ASSERT_TRUE(cache.Lookup("0", value));
+    cache.Insert("10", 10);
+    ASSERT_EQ(cache.Size(), 10);
+    // "0" was hit and moved to the main queue, "1" is the oldest entry never hit
+    ASSERT_TRUE(cache.Exists("0"));
+    ASSERT_FALSE(cache.Exists("1"));
+    ASSERT_TRUE(cache.Exists("10"));
+}
+
+TEST(ShardedCacheTest, scan_resistant) {
+    ShardedCache<size_t, size_t> cache(1000, 0);
+    // hot set hit a few times
+    for (size_t round = 0; round < 3; round++) {
+        for (size_t i = 0; i < 500; i++) {
+            size_t value = 0;
+            if (!cache.Lookup(i, value)) {
+                cache.Insert(i, i);
+            }
+        }
+    }
+    // a scan much larger than the cache touching every key once
+    for (size_t i = 1000; i < 100000; i++) {
+        cache.Insert(i, i);
+    }
+    size_t hit = 0;
+    for (size_t i = 0; i < 500; i++) {
+        hit += cache.Exists(i);
+    }
+    ASSERT_EQ(hit, 500);
+}
+
+TEST(ShardedCacheTest, hint) {
+    ShardedCache<size_t, size_t> cache(100, 0);
+    cache.Insert(1, 1, 1, CacheHint::NO_FILL);
+    ASSERT_FALSE(cache.Exists(1));
+    cache.Insert(1, 1);
+    cache.Insert(1, 2, 1, CacheHint::NO_FILL);
+    size_t value = 0;
+    ASSERT_TRUE(cache.Lookup(1, value));
+    ASSERT_EQ(value, 2);
+
+    // low priority entries are evicted before normal ones hit once
+    ShardedCache<size_t, size_t> hint_cache(100, 0);
+    for (size_t i = 0; i < 90; i++) {
+        hint_cache.Insert(i, i);
+        hint_cache.Lookup(i, value);
+    }
+    for (size_t i = 100; i < 10000; i++) {
+        hint_cache.Insert(i, i, 1, CacheHint::LOW_PRIORITY);
+        hint_cache.Lookup(i, value);
+    }
+    for (size_t i = 0; i < 90; i++) {
+        ASSERT_TRUE(hint_cache.Exists(i));
+    }
+}
+
+TEST(ShardedCacheTest, charge) {
+    ShardedCache<size_t, size_t> cache(64 * 1024, 0);
+    for (size_t i = 0; i < 100; i++) {
+        cache.Insert(i, i, 4096);
+    }
+    ASSERT_EQ(cache.Size(), 16);
+    ASSERT_EQ(cache.GetUsage(), 64 * 1024);
+    // growing an entry evicts others to stay in budget
+    cache.Insert(99, 99, 32 * 1024);
+    ASSERT_LE(cache.GetUsage(), 64 * 1024);
+    ASSERT_TRUE(cache.Exists(99));
+    cache.SetCapacity(16 * 1024);
+    ASSERT_LE(cache.GetUsage(), 16 * 1024);
+}
+
+TEST(ShardedCacheTest, evict_callback) {
+    ShardedCache<size_t, size_t> cache(10, 0);
+    std::vector<size_t> evicted;
+    cache.SetEvictCallback([&](const size_t &key, const size_t &value) { evicted.push_back(key); });
+    for (size_t i = 0; i < 20; i++) {
+        cache.Insert(i, i);
+    }
+    ASSERT_EQ(evicted.size(), 10);
+    ASSERT_EQ(evicted[0], 0);
+    // scans do not spill into the lower tier
+    for (size_t i = 100; i < 120; i++) {
+        cache.Insert(i, i, 1, CacheHint::LOW_PRIORITY);
+    }
+    for (size_t key : evicted) {
+        ASSERT_LT(key, 100);
+    }
+    cache.Erase(119);
+    ASSERT_NE(evicted.back(), 119);
+}
+
+TEST(ShardedCacheTest, retire_callback) {
+    ShardedCache<size_t, std::shared_ptr<int>> cache(4, 0);
+    std::vector<std::shared_ptr<int>> retired;
+    cache.SetRetireCallback([&](std::shared_ptr<int> &&value) { retired.push_back(std::move(value)); });
+    for (int i = 0; i < 6; i++) {
+        cache.Insert(i, std::make_shared<int>(i));
+    }
+    ASSERT_EQ(retired.size(), 2);
+    int *raw = nullptr;
+    ASSERT_TRUE(cache.LookupRaw(5, raw));
+    ASSERT_EQ(*raw, 5);
+    cache.Insert(5, std::make_shared<int>(10));
+    cache.Erase(4);
+    // the replaced and the erased values are handed over too, the raw pointer stays valid
+    ASSERT_EQ(retired.size(), 4);
+    ASSERT_EQ(*raw, 5);
+}
+
+TEST(ShardedCacheTest, hot_keys) {
+    ShardedCache<size_t, int> cache(1024, 2);
+    for (int i = 0; i < 10; i++) {
+        cache.Insert(i, i);
+    }
+    int value = 0;
+    for (int i = 0; i < 3; i++) {
+        cache.Lookup(7, value);
+    }
+    cache.Lookup(3, value);
+    std::vector<size_t> keys = cache.HotKeys(4);
+    ASSERT_EQ(keys.size(), 4);
+    ASSERT_EQ(keys[0], 7);
+    ASSERT_EQ(keys[1], 3);
+    ASSERT_EQ(cache.HotKeys(100).size(), 10);
+}
+
+TEST(ShardedCacheTest, concurrent) {
+    ShardedCache<size_t, size_t> cache(1 << 16, 6);
+    for (size_t i = 0; i < 10000; i++) {
+        cache.Insert(i, i);
+    }
+    std::atomic<size_t> errors = 0;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; t++) {
+        threads.emplace_back([&, t]() {
+            for (size_t n = 0; n < 100000; n++) {
+                size_t key = (n * 31 + t) % 20000;
+                size_t value = 0;
+                if (key >= 10000) {
+                    cache.Insert(key, key);
+                } else if (!cache.Lookup(key, value) || value != key) {
+                    errors++;
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    ASSERT_EQ(errors, 0);
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest();
+    return RUN_ALL_TESTS();
+}
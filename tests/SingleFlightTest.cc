@@ -0,0 +1,66 @@
+#include "utils/SingleFlight.h"
+#include <atomic>
+#include <chrono>
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+using namespace rangedb;
+
+TEST(SingleFlightTest, coalesce) {
+    SingleFlight<int, int> flight;
+    std::atomic<int> calls = 0;
+    std::atomic<int> shared_num = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; i++) {
+        threads.emplace_back([&]() {
+            bool shared = false;
+            int value = flight.Do(
+                1,
+                [&]() {
+                    calls++;
+                    // a slow disk read, the other threads arrive while it runs
+                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                    return 42;
+                },
+                &shared);
+            ASSERT_EQ(value, 42);
+            if (shared) {
+                shared_num++;
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    ASSERT_EQ(calls, 1);
+    ASSERT_EQ(shared_num, 7);
+    ASSERT_EQ(flight.InflightNum(), 0);
+}
+
+TEST(SingleFlightTest, distinct_keys) {
+    SingleFlight<int, int> flight;
+    std::atomic<int> calls = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++) {
+        threads.emplace_back([&, i]() {
+            int value = flight.Do(i, [&]() {
+                calls++;
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                return i;
+            });
+            ASSERT_EQ(value, i);
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    ASSERT_EQ(calls, 4);
+    // nothing is cached once the call is done
+    ASSERT_EQ(flight.Do(0, [&]() { return 100; }), 100);
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest();
+    return RUN_ALL_TESTS();
+}
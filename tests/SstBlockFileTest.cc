@@ -6,9 +6,13 @@
 #include "utils/FileHandle.h"
 #include "utils/Slice.h"
 #include "gtest/gtest.h"
+#include <atomic>
 #include <cstddef>
+#include <cstdio>
 #include <cstdint>
 #include <string>
+#include <thread>
+#include <vector>
 
 using namespace rangedb;
 
@@ -108,6 +112,142 @@ void IterateTest(storage::SstBlockFile *block_file) {
     }
 }
 
+TEST(BlockTest, partial_read) {
+    storage::SstBlockFile *block_file = new storage::SstBlockFile(1);
+    std::vector<Slice> slices;
+    for (int i = 0; i < 10000; i++) {
+        std::string str_key = "key" + std::to_string(i);
+        Slice slice;
+        slice.key_ = ByteKey((int8_t *)str_key.c_str(), str_key.size());
+        slice.data_ = resp::buffer((char *)"value", 5);
+        slice.version_ = i;
+        slice.data_length_ = slice.Size();
+        block_file->Append(&slice);
+        slices.emplace_back(slice);
+    }
+    ASSERT_TRUE(block_file->Flush().ok());
+    for (auto &slice : slices) {
+        RecordPtr record = block_file->ReadRecord(slice.block_id_, slice.offset_, slice.data_length_);
+        ASSERT_NE(record, nullptr);
+        Slice read_slice;
+        read_slice.Deserialize((int8_t *)record->data());
+        ASSERT_EQ(read_slice.key_.ToString(), slice.key_.ToString());
+        ASSERT_EQ(read_slice.version_, slice.version_);
+    }
+    block_file->GetFileHandle()->DeleteFile();
+}
+
+TEST(BlockTest, concurrent_first_get) {
+    const uint64_t file_id = 900002;
+    const int key_num = 10000;
+    auto make_key = [](int i) {
+        char key[16];
+        snprintf(key, sizeof(key), "key%06d", i);
+        return std::string(key);
+    };
+    {
+        storage::SstBlockFile block_file(file_id);
+        for (int i = 0; i < key_num; i++) {
+            std::string str_key = make_key(i);
+            Slice slice;
+            slice.key_ = ByteKey((int8_t *)str_key.c_str(), str_key.size());
+            slice.data_ = resp::buffer((char *)"value", 5);
+            slice.version_ = i;
+            slice.data_length_ = slice.Size();
+            block_file.Append(&slice);
+        }
+        ASSERT_TRUE(block_file.Flush().ok());
+        ASSERT_GT(block_file.GetBlockNum(), 1);
+    }
+
+    // the first Gets of a file opened for reads load its header together
+    storage::SstBlockFile block_file(file_id);
+    std::atomic<int> found{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; t++) {
+        threads.emplace_back([&, t]() {
+            for (int i = t; i < key_num; i += 97) {
+                std::string str_key = make_key(i);
+                Slice slice;
+                slice.key_ = ByteKey((int8_t *)str_key.c_str(), str_key.size());
+                if (block_file.Get(&slice).ok() && slice.version_ == (uint64_t)i) {
+                    found++;
+                }
+            }
+        });
+    }
+    int expected = 0;
+    for (int t = 0; t < 8; t++) {
+        for (int i = t; i < key_num; i += 97) {
+            expected++;
+        }
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(found, expected);
+    block_file.GetFileHandle()->DeleteFile();
+}
+
+TEST(BlockTest, value_outlives_block) {
+    const uint64_t file_id = 900003;
+    const int key_num = 10000;
+    auto make_key = [](int i) {
+        char key[16];
+        snprintf(key, sizeof(key), "key%06d", i);
+        return std::string(key);
+    };
+    {
+        storage::SstBlockFile block_file(file_id);
+        for (int i = 0; i < key_num; i++) {
+            std::string str_key = make_key(i);
+            Slice slice;
+            slice.key_ = ByteKey((int8_t *)str_key.c_str(), str_key.size());
+            slice.data_ = resp::buffer(str_key.c_str(), str_key.size());
+            slice.data_length_ = slice.Size();
+            block_file.Append(&slice);
+        }
+        ASSERT_TRUE(block_file.Flush().ok());
+        ASSERT_GT(block_file.GetBlockNum(), 2);
+    }
+    storage::SstBlockFile block_file(file_id);
+    auto get = [&](int i, Slice *slice) {
+        std::string str_key = make_key(i);
+        slice->key_ = ByteKey((int8_t *)str_key.c_str(), str_key.size());
+        return block_file.Get(slice).ok();
+    };
+    Slice first;
+    ASSERT_TRUE(get(0, &first));
+    // a cache hit now, the value is read from the block pinned by the epoch
+    Slice slice;
+    ASSERT_TRUE(get(0, &slice));
+    // the block is evicted and released while the value is still read, the buffers of the
+    // blocks read next may take its place
+    BlockManager *block_manager = BlockManager::GetInstance().get();
+    block_manager->SetBlockCacheCapacity(0);
+    EpochManager::GetInstance()->Reclaim();
+    block_manager->SetBlockCacheCapacity(storage::BLOCK_CACHE_CAPACITY);
+    for (int i = key_num - 1; i > 0; i -= 100) {
+        Slice other;
+        ASSERT_TRUE(get(i, &other));
+    }
+    EXPECT_EQ(std::string(slice.data_.data(), slice.data_.size()), make_key(0));
+    block_file.GetFileHandle()->DeleteFile();
+}
+
+TEST(BlockTest, record_cache_key) {
+    BlockManager block_manager;
+    // file ids are 64-bit, file 2^32 must not share the records of file 0
+    uint64_t high_file_id = 1ULL << 32;
+    block_manager.AddRecordCache(0, 0, 16, std::make_shared<std::string>("low"));
+    block_manager.AddRecordCache(high_file_id, 0, 16, std::make_shared<std::string>("high"));
+    ASSERT_NE(block_manager.GetRecord(0, 0, 16), nullptr);
+    ASSERT_NE(block_manager.GetRecord(high_file_id, 0, 16), nullptr);
+    EXPECT_EQ(*block_manager.GetRecord(0, 0, 16), "low");
+    EXPECT_EQ(*block_manager.GetRecord(high_file_id, 0, 16), "high");
+    EXPECT_EQ(block_manager.GetRecord(0, 1, 16), nullptr);
+}
+
 TEST(BlockTest, base) {
     // auto block_file = CreateBlockFileTest();
     // IterateTest(block_file);
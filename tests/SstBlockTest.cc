@@ -79,6 +79,31 @@ void IterateTest(storage::SstBlock *block) {
     }
 }
 
+TEST(BlockTest, hash_index) {
+    storage::SstBlock *block = CreateBlockTest();
+    block->Finshed();
+    for (int i = 0; i < 500; i++) {
+        std::string str_key = "key" + std::to_string(i);
+        Slice slice;
+        slice.key_ = ByteKey((int8_t *)str_key.c_str(), str_key.size());
+        ASSERT_TRUE(block->Get(&slice));
+        ASSERT_EQ(slice.version_, i);
+    }
+    Slice slice;
+    slice.key_ = ByteKey((int8_t *)"key500", 6);
+    ASSERT_FALSE(block->Get(&slice));
+
+    // a block read back from disk keeps its index
+    storage::SstBlock read_block(0);
+    int8_t *data = storage::BlockBufferPool()->Allocate();
+    std::memcpy(data, block->GetData(), storage::BLOCK_SIZE);
+    read_block.InitFromData(data);
+    slice.key_ = ByteKey((int8_t *)"key42", 5);
+    ASSERT_TRUE(read_block.Get(&slice));
+    ASSERT_EQ(slice.version_, 42);
+    delete block;
+}
+
 TEST(BlockTest, base) {
     auto block = CreateBlockTest();
     IterateTest(block);
@@ -2,10 +2,13 @@
 #include "storage/block/Block.h"
 #include "storage/walblock/WalBlock.h"
 #include "utils/Comparator.h"
+#include "utils/FileHandle.h"
 #include "utils/Slice.h"
 #include "gtest/gtest.h"
 #include <cstdint>
 #include <string>
+#include <unistd.h>
+#include <vector>
 
 using namespace rangedb;
 
@@ -85,6 +88,203 @@ TEST(BlockTest, base) {
     IterateTest(block_file);
 }
 
+TEST(BlockTest, recover_from_file) {
+    const uint64_t file_id = 900001;
+    const int record_num = 3000;
+    std::vector<std::string> keys;
+    {
+        WalBlockFile block_file(file_id);
+        ASSERT_TRUE(block_file.Open().ok());
+        for (int i = 0; i < record_num; i++) {
+            keys.push_back("key_" + std::to_string(i));
+            Slice slice;
+            slice.key_ = ByteKey((int8_t *)keys.back().c_str(), keys.back().size());
+            slice.data_ = resp::buffer((char *)"value", 5);
+            slice.version_ = i;
+            block_file.Append(&slice);
+            EXPECT_EQ(slice.file_id_, file_id);
+            if (i % 1000 == 0) {
+                ASSERT_TRUE(block_file.Write().ok());
+            }
+        }
+        ASSERT_TRUE(block_file.Flush().ok());
+        EXPECT_GT(block_file.GetBlockNum(), 1);
+    }
+
+    WalBlockFile recovered(file_id);
+    ASSERT_TRUE(recovered.Load().ok());
+    int i = 0;
+    recovered.ForEachRecord([&](Slice *slice) {
+        ASSERT_LT(i, record_num);
+        EXPECT_EQ(slice->key_.ToString(), keys[i]);
+        EXPECT_EQ(slice->version_, i);
+        EXPECT_EQ(slice->file_id_, file_id);
+        EXPECT_EQ(std::string(slice->data_.data(), slice->data_.size()), "value");
+        i++;
+    });
+    // the zeros preallocated after the last record are not read as records
+    EXPECT_EQ(i, record_num);
+    unlink((std::to_string(file_id) + ".wal").c_str());
+}
+
+TEST(BlockTest, recover_stops_at_bad_checksum) {
+    const uint64_t file_id = 900004;
+    const int record_num = 3000;
+    const int bad_record = 10;
+    std::string file_name = std::to_string(file_id) + ".wal";
+    Slice bad_slice;
+    {
+        WalBlockFile block_file(file_id);
+        ASSERT_TRUE(block_file.Open().ok());
+        for (int i = 0; i < record_num; i++) {
+            std::string key = "key_" + std::to_string(i);
+            Slice slice;
+            slice.key_ = ByteKey((int8_t *)key.c_str(), key.size());
+            slice.data_ = resp::buffer((char *)"value", 5);
+            block_file.Append(&slice);
+            if (i == bad_record) {
+                bad_slice = slice;
+            }
+        }
+        ASSERT_TRUE(block_file.Flush().ok());
+        EXPECT_GT(block_file.GetBlockNum(), 1);
+    }
+    // flip the last byte of the value, the header of the record is still valid
+    FileHandle file_handle(file_name);
+    ASSERT_TRUE(file_handle.Open());
+    off64_t value_end = bad_slice.block_id_ * storage::BLOCK_SIZE + bad_slice.offset_ + bad_slice.data_length_ - 1;
+    int8_t byte = 0;
+    ASSERT_TRUE(file_handle.Read(&byte, 1, value_end));
+    byte ^= 0x1;
+    ASSERT_TRUE(file_handle.WriteAt(&byte, 1, value_end));
+    file_handle.Close();
+
+    // the records of the later blocks are not replayed either
+    WalBlockFile recovered(file_id);
+    ASSERT_TRUE(recovered.Load().ok());
+    int i = 0;
+    recovered.ForEachRecord([&](Slice *slice) {
+        EXPECT_EQ(slice->key_.ToString(), "key_" + std::to_string(i));
+        i++;
+    });
+    EXPECT_EQ(i, bad_record);
+    EXPECT_EQ(recovered.GetBlockNum(), bad_slice.block_id_ + 1);
+    unlink(file_name.c_str());
+}
+
+TEST(BlockTest, recover_drops_partial_batch) {
+    const uint64_t file_id = 900005;
+    std::string file_name = std::to_string(file_id) + ".wal";
+    auto make_batch = [](const std::string &prefix, int num) {
+        std::vector<Slice> batch(num);
+        for (int i = 0; i < num; i++) {
+            std::string key = prefix + std::to_string(i);
+            batch[i].key_ = ByteKey((int8_t *)key.c_str(), key.size());
+            batch[i].data_ = resp::buffer((char *)"value", 5);
+        }
+        return batch;
+    };
+    std::vector<Slice> put = make_batch("put_", 1);
+    std::vector<Slice> whole = make_batch("whole_", 3);
+    std::vector<Slice> torn = make_batch("torn_", 5);
+    {
+        WalBlockFile block_file(file_id);
+        ASSERT_TRUE(block_file.Open().ok());
+        block_file.Append(&put[0]);
+        ASSERT_EQ(block_file.AppendBatch(whole), DB_SUCCESS);
+        ASSERT_EQ(block_file.AppendBatch(torn), DB_SUCCESS);
+        ASSERT_TRUE(block_file.Flush().ok());
+    }
+    // the last record of the batch never reached the file
+    FileHandle file_handle(file_name);
+    ASSERT_TRUE(file_handle.Open());
+    std::vector<int8_t> zeros(storage::RecordSize(torn.back()), 0);
+    ASSERT_TRUE(file_handle.WriteAt(zeros.data(), zeros.size(), torn.back().block_id_ * storage::BLOCK_SIZE + torn.back().offset_));
+    file_handle.Close();
+
+    WalBlockFile recovered(file_id);
+    ASSERT_TRUE(recovered.Load().ok());
+    std::vector<std::string> keys;
+    recovered.ForEachRecord([&](Slice *slice) { keys.push_back(slice->key_.ToString()); });
+    std::vector<std::string> expected{"put_0", "whole_0", "whole_1", "whole_2"};
+    EXPECT_EQ(keys, expected);
+    unlink(file_name.c_str());
+}
+
+TEST(BlockTest, drop_last_batch) {
+    const uint64_t file_id = 900006;
+    std::string file_name = std::to_string(file_id) + ".wal";
+    std::vector<Slice> put(1);
+    std::vector<Slice> part(3000);
+    for (size_t i = 0; i < part.size(); i++) {
+        std::string key = "part_" + std::to_string(i);
+        part[i].key_ = ByteKey((int8_t *)key.c_str(), key.size());
+        part[i].data_ = resp::buffer((char *)"value", 5);
+    }
+    put[0] = part[0];
+    {
+        WalBlockFile block_file(file_id);
+        ASSERT_TRUE(block_file.Open().ok());
+        ASSERT_EQ(block_file.AppendBatch(put), DB_SUCCESS);
+        // a part of a batch spanning memtables, over more than one block
+        ASSERT_EQ(block_file.AppendBatch(part, 7), DB_SUCCESS);
+        ASSERT_TRUE(block_file.Flush().ok());
+        ASSERT_GT(block_file.GetBlockNum(), 1);
+    }
+    WalBlockFile recovered(file_id);
+    ASSERT_TRUE(recovered.Load().ok());
+    EXPECT_EQ(recovered.GetLastSeq(), 7);
+    ASSERT_TRUE(recovered.DropLastBatch().ok());
+    EXPECT_EQ(recovered.GetRecordNum(), 1);
+    EXPECT_EQ(recovered.GetLastSeq(), 0);
+
+    // the file lost the batch too
+    WalBlockFile reloaded(file_id);
+    ASSERT_TRUE(reloaded.Load().ok());
+    EXPECT_EQ(reloaded.GetRecordNum(), 1);
+    unlink(file_name.c_str());
+}
+
+TEST(BlockTest, sorted_records) {
+    WalBlockFile block_file(0);
+    const int key_num = 2000;
+    std::vector<std::string> keys;
+    // every key twice, the second put in a later block, with keys sharing their 7 byte prefix
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < key_num; i++) {
+            keys.push_back("sorted_" + std::to_string((i * 7919) % key_num));
+            Slice slice;
+            slice.key_ = ByteKey((int8_t *)keys.back().c_str(), keys.back().size());
+            slice.data_ = resp::buffer((char *)"value", 5);
+            slice.version_ = round;
+            block_file.Append(&slice);
+        }
+    }
+    EXPECT_GT(block_file.GetBlockNum(), 1);
+    block_file.SortRecords();
+
+    Iterator *iter = block_file.NewIterator(ByteKeyComparator());
+    iter->SeekToFirst();
+    int num = 0;
+    ByteKey last_key;
+    while (!iter->End()) {
+        if (num > 0) {
+            EXPECT_TRUE(last_key < iter->Key());
+        }
+        EXPECT_EQ(iter->Value().version_, 1);
+        last_key = iter->Key();
+        num++;
+        iter->Next();
+    }
+    EXPECT_EQ(num, key_num);
+
+    std::string target = "sorted_1000";
+    iter->Seek(ByteKey((int8_t *)target.c_str(), target.size()));
+    ASSERT_FALSE(iter->End());
+    EXPECT_EQ(iter->Key().ToString(), target);
+    delete iter;
+}
+
 int main(int argc, char **argv) {
     testing::InitGoogleTest();
     return RUN_ALL_TESTS();
@@ -20,7 +20,7 @@ target("dblib")
     add_includedirs("src", "thirdparty/", "thirdparty/libcoro/include/", "thirdparty/libcoro/Release/include/", "thirdparty/libcoro/vendor/c-ares/c-ares/include", 
         "thirdparty/libcoro/vendor/c-ares/c-ares/build",  "thirdparty/libcoro/vendor/c-ares/c-ares/build/include")
     add_files("src/**/*.cc")
-    add_links("pthread", "gtest", "coro")
+    add_links("pthread", "gtest", "coro", "uring", "lz4")
     add_linkdirs("thirdparty/libcoro/Release")
     add_cxflags("-g", "-fcoroutines")
     add_cxflags("-mavx2", "-msse4", "-msha")
@@ -49,7 +49,7 @@ target("echo_server")
     add_deps("dblib")
     add_cxflags("-g", "-fcoroutines")
     add_linkdirs("thirdparty/libcoro/Release")
-    add_links("coro", "pthread")
+    add_links("coro", "pthread", "uring", "lz4")
     add_cxflags("-std=c++20")
 target_end()
 
@@ -68,5 +68,5 @@ for _, file in ipairs(os.files("tests/*.cc")) do
         add_cxflags("-std=c++20", "-fcoroutines")
         add_cxflags("-g")
         add_linkdirs("thirdparty/libcoro/Release")
-        add_links("coro", "pthread")
+        add_links("coro", "pthread", "uring", "lz4")
 end
\ No newline at end of file